@@ -0,0 +1,14 @@
+#version 410
+
+layout(location = 0) in vec2 inTranslation;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in float inSize;
+
+out vec4 fragColor;
+
+// Items too small to show their shape, as square points of inSize pixels
+void main() {
+  gl_Position = vec4(inTranslation, 0, 1);
+  gl_PointSize = inSize;
+  fragColor = inColor;
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 410
+
+layout(location = 0) in vec2 inTranslation;
+
+out vec2 translation;
+flat out int index;
+
+void main() {
+  translation = inTranslation;
+  index = gl_VertexID;
+}
@@ -0,0 +1,55 @@
+#version 410
+
+layout(location = 0) in vec2 inPreviousTranslation;
+layout(location = 1) in float inPreviousRotation;
+layout(location = 2) in vec2 inTranslation;
+layout(location = 3) in float inRotation;
+layout(location = 4) in vec4 inColor;
+layout(location = 5) in float inScale;
+layout(location = 6) in int inMesh;
+
+// Fan vertices of every mesh, and where each mesh starts (Items::numMeshes)
+uniform samplerBuffer meshPool;
+uniform int meshFirst[40];
+uniform int meshCount[40];
+
+uniform float interpolation;
+
+out vec4 fragColor;
+
+const float pi = 3.14159265359;
+
+void main() {
+  // Meshes with fewer vertices than the draw repeat their last one
+  int vertex = meshFirst[inMesh] + min(gl_VertexID, meshCount[inMesh] - 1);
+  vec2 position = texelFetch(meshPool, vertex).xy;
+
+  vec2 delta = inTranslation - inPreviousTranslation;
+  delta -= 2.0 * round(delta * 0.5);
+  vec2 translation = inPreviousTranslation + delta * interpolation;
+
+  float turn = mod(inRotation - inPreviousRotation + pi, 2.0 * pi) - pi;
+  float rotation = inPreviousRotation + turn * interpolation;
+
+  // Nine instances per item, one for each copy of the wrapped world
+  int tile = gl_InstanceID % 9;
+  vec2 tileOffset = vec2(tile % 3 - 1, tile / 3 - 1) * 2.0;
+
+  // Copies that cannot reach the view collapse to a point outside of it,
+  // so their triangles are dropped before rasterization
+  vec2 reach = abs(translation + tileOffset) - inScale;
+  if (any(greaterThanEqual(reach, vec2(1.0)))) {
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    fragColor = vec4(0.0);
+    return;
+  }
+
+  float sinAngle = sin(rotation);
+  float cosAngle = cos(rotation);
+  vec2 rotated = vec2(position.x * cosAngle - position.y * sinAngle,
+                      position.x * sinAngle + position.y * cosAngle);
+
+  vec2 newPosition = rotated * inScale + translation + tileOffset;
+  gl_Position = vec4(newPosition, 0, 1);
+  fragColor = inColor;
+}
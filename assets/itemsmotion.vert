@@ -0,0 +1,26 @@
+#version 410
+
+layout(location = 0) in vec2 inTranslation;
+layout(location = 1) in float inRotation;
+layout(location = 2) in vec2 inVelocity;
+layout(location = 3) in float inAngularVelocity;
+
+uniform vec2 carOffset;
+uniform float deltaTime;
+
+out vec2 outTranslation;
+out float outRotation;
+
+const float twoPi = 6.28318530718;
+
+// Same step and wrap-around as Items::update
+void main() {
+  vec2 translation = inTranslation - carOffset + inVelocity * deltaTime;
+  translation += 2.0 * vec2(lessThan(translation, vec2(-1.0))) -
+                 2.0 * vec2(greaterThan(translation, vec2(1.0)));
+  outTranslation = translation;
+
+  float rotation = inRotation + inAngularVelocity * deltaTime;
+  rotation += twoPi * (float(rotation < 0.0) - float(rotation >= twoPi));
+  outRotation = rotation;
+}
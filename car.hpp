@@ -1,45 +1,55 @@
 #ifndef CAR_HPP_
 #define CAR_HPP_
 
-#include "abcg.hpp"
+#include <array>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
 #include "gamedata.hpp"
 
 
-class OpenGLWindow;
+class CarRenderer;
 class Items;
+class OpenGLWindow;
+class Snapshot;
+class SoftwareRenderer;
+class World;
 
 class Car {
  public:
-  void initializeGL(GLuint program);
-  void paintGL(const GameData &gameData);
-  void terminateGL();
-
+  void reset();
   void update(const GameData &gameData, float deltaTime);
   void setRotation(float rotation) { m_rotation = rotation; }
 
+  // Indexed triangles in units of the car's scale: the body in green, the
+  // wheels in black
+  struct Mesh {
+    std::array<glm::vec2, 26> m_positions;
+    std::array<glm::vec4, 26> m_colors;
+    std::array<unsigned int, 36> m_indices;
+  };
+  [[nodiscard]] static const Mesh &mesh();
+
  private:
-  friend OpenGLWindow;
+  friend CarRenderer;
   friend Items;
+  friend OpenGLWindow;
+  friend Snapshot;
+  friend SoftwareRenderer;
+  friend World;
 
 
-  GLuint me_program{};
-  GLint m_translationLoc{};
-  GLint m_colorLoc{};
-  GLint m_scaleLoc{};
-  GLint m_rotationLoc{};
-
-  GLuint m_vao{};
-  GLuint m_vbo{};
-  GLuint m_vbo_color{};
-  GLuint m_ebo{};
-
-  glm::vec4 m_color{1};
   float m_rotation{};
   float m_scale{0.17f};
   glm::vec2 m_translation{glm::vec2(0)};
   glm::vec2 m_velocity{glm::vec2(0)};
 
-  abcg::ElapsedTimer m_trailBlinkTimer;
-  abcg::ElapsedTimer m_bulletCoolDownTimer;
+  // State at the start of the last simulation tick, for render interpolation
+  float m_previousRotation{};
+  glm::vec2 m_previousTranslation{glm::vec2(0)};
+
+  [[nodiscard]] glm::vec2 renderTranslation(float interpolation) const;
+  [[nodiscard]] float renderRotation(float interpolation) const;
 };
 #endif
\ No newline at end of file
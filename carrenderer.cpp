@@ -0,0 +1,125 @@
+#include "carrenderer.hpp"
+
+#include <cstddef>
+
+void CarRenderer::initializeGL(GLuint program) {
+  terminateGL();
+
+  m_program = program; 
+
+  const auto &mesh{Car::mesh()};
+  const auto &positions{mesh.m_positions};
+  const auto &colors{mesh.m_colors};
+  const auto &indices{mesh.m_indices};
+
+  abcg::glGenBuffers(1, &m_vbo);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  abcg::glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions.data(),
+                     GL_STATIC_DRAW);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  
+  abcg::glGenBuffers(1, &m_vbo_color);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_vbo_color);
+  abcg::glBufferData(GL_ARRAY_BUFFER, sizeof(colors), colors.data(),
+                     GL_STATIC_DRAW);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0); 
+  
+  abcg::glGenBuffers(1, &m_ebo);
+  abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+  abcg::glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices.data(),
+                     GL_STATIC_DRAW);
+  abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  m_indexCount = static_cast<GLsizei>(indices.size());
+  
+  GLint positionAttribute{abcg::glGetAttribLocation(m_program, "inPosition")};
+
+  GLint colorAttribute{abcg::glGetAttribLocation(m_program, "inColor")};
+
+  abcg::glGenVertexArrays(1, &m_vao);
+
+  abcg::glBindVertexArray(m_vao);
+
+  abcg::glEnableVertexAttribArray(positionAttribute);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  abcg::glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, GL_FALSE, 0,
+                              nullptr);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  abcg::glEnableVertexAttribArray(colorAttribute);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_vbo_color);
+  abcg::glVertexAttribPointer(colorAttribute, 4, GL_FLOAT, GL_FALSE, 0,
+                              nullptr);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  for (auto location : {2, 3, 4}) {
+    abcg::glEnableVertexAttribArray(location);
+    abcg::glVertexAttribDivisor(location, 1);
+  }
+
+  abcg::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+  
+  abcg::glBindVertexArray(0);
+}
+
+void CarRenderer::paintGL(const Car &car, const GameData &gameData,
+                          StreamBuffer &stream, RenderQueue &queue,
+                          float interpolation) {
+  if (gameData.m_state != State::Playing) return;
+
+  const auto rotation{car.renderRotation(interpolation)};
+  const auto translation{car.renderTranslation(interpolation)};
+
+  std::size_t offset{};
+  auto *instance{stream.allocate<Instance>(1, offset)};
+  instance->m_translation = translation;
+  instance->m_rotation = rotation;
+  instance->m_scale = car.m_scale;
+  stream.commit();
+
+  abcg::glBindVertexArray(m_vao);
+
+  const auto stride{static_cast<GLsizei>(sizeof(Instance))};
+  const auto pointer{[offset](std::size_t member) {
+    return reinterpret_cast<void *>(offset + member);
+  }};
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+  abcg::glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_translation)));
+  abcg::glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_rotation)));
+  abcg::glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_scale)));
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  abcg::glBindVertexArray(0);
+
+  RenderQueue::Draw draw{};
+  draw.m_layer = RenderQueue::Layer::Car;
+  draw.m_program = m_program;
+  draw.m_vao = m_vao;
+  draw.m_indexed = true;
+  
+  if (m_trailBlinkTimer.elapsed() > 100.0 / 1000.0) m_trailBlinkTimer.restart();
+
+  if (gameData.m_input[static_cast<size_t>(Input::Up)]) {    
+    if (m_trailBlinkTimer.elapsed() < 50.0 / 1000.0) {
+      auto trail{draw};
+      trail.m_layer = RenderQueue::Layer::CarTrail;
+      trail.m_blend = true;
+      trail.m_count = m_indexCount;
+      queue.submit(trail);
+    }
+  }
+ 
+  draw.m_count = m_indexCount;
+  queue.submit(draw);
+}
+
+// Names are zeroed, so that calling this again, as initializeGL() does,
+// cannot delete objects that reused them
+void CarRenderer::terminateGL() {
+  abcg::glDeleteBuffers(1, &m_vbo);
+  abcg::glDeleteBuffers(1, &m_vbo_color);
+  abcg::glDeleteBuffers(1, &m_ebo);
+  abcg::glDeleteVertexArrays(1, &m_vao);
+  m_vbo = m_vbo_color = m_ebo = m_vao = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef CARRENDERER_HPP_
+#define CARRENDERER_HPP_
+
+#include "abcg.hpp"
+#include "car.hpp"
+#include "gamedata.hpp"
+#include "renderqueue.hpp"
+#include "streambuffer.hpp"
+
+class CarRenderer {
+ public:
+  void initializeGL(GLuint program);
+  // Submits the car's draws to queue
+  void paintGL(const Car &car, const GameData &gameData, StreamBuffer &stream,
+               RenderQueue &queue, float interpolation = 1.0f);
+  void terminateGL();
+
+ private:
+  // Streamed once per frame, read at the locations fixed by car.vert
+  struct Instance {
+    glm::vec2 m_translation{glm::vec2(0)};
+    float m_rotation{};
+    float m_scale{};
+  };
+
+  GLuint m_program{};
+
+  GLuint m_vao{};
+  GLuint m_vbo{};
+  GLuint m_vbo_color{};
+  GLuint m_ebo{};
+  GLsizei m_indexCount{};
+
+  abcg::ElapsedTimer m_trailBlinkTimer;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "framepacer.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "abcg.hpp"
+
+FramePacer::VSync FramePacer::setVSync(VSync mode) {
+#if !defined(__EMSCRIPTEN__)
+  if (mode == VSync::Adaptive && SDL_GL_SetSwapInterval(-1) != 0) {
+    mode = VSync::On;
+  }
+  if (mode != VSync::Adaptive) {
+    SDL_GL_SetSwapInterval(mode == VSync::On ? 1 : 0);
+  }
+  m_vSync = mode;
+#else
+  (void)mode;
+  m_vSync = VSync::On;
+#endif
+  return m_vSync;
+}
+
+void FramePacer::setMaxFps(int fps) {
+  m_maxFps = std::max(0, fps);
+  m_nextFrame = {};
+}
+
+// Sleeps are only as precise as the scheduler, often a millisecond or
+// worse, so the last millisecond is spun. A frame later than a whole period
+// restarts the schedule instead of rushing to catch up
+void FramePacer::pace() {
+#if !defined(__EMSCRIPTEN__)
+  if (m_maxFps == 0) return;
+
+  const auto period{std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / m_maxFps))};
+  const auto now{Clock::now()};
+  if (m_nextFrame == Clock::time_point{} || now > m_nextFrame + period) {
+    m_nextFrame = now;
+  } else {
+    const auto spin{std::chrono::milliseconds(1)};
+    if (m_nextFrame - now > spin) {
+      std::this_thread::sleep_until(m_nextFrame - spin);
+    }
+    while (Clock::now() < m_nextFrame) {
+      std::this_thread::yield();
+    }
+  }
+  m_nextFrame += period;
+#endif
+}
+
+void FramePacer::waitForEvent(double timeout) {
+#if !defined(__EMSCRIPTEN__)
+  SDL_WaitEventTimeout(nullptr, static_cast<int>(timeout * 1000.0));
+#else
+  (void)timeout;
+#endif
+}
+
+void FramePacer::account(bool idle, double gpu) {
+  const auto wall{Clock::now()};
+  const auto cpu{std::clock()};
+
+  auto &usage{idle ? m_idle : m_active};
+  usage.wall += std::chrono::duration<double>(wall - m_lastWall).count();
+  usage.cpu += static_cast<double>(cpu - m_lastCpu) / CLOCKS_PER_SEC;
+  usage.gpu += gpu - m_lastGpu;
+
+  m_lastWall = wall;
+  m_lastCpu = cpu;
+  m_lastGpu = gpu;
+}
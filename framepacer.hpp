@@ -0,0 +1,59 @@
+#ifndef FRAMEPACER_HPP_
+#define FRAMEPACER_HPP_
+
+#include <chrono>
+#include <ctime>
+
+// Paces the frames of the window: a frame-rate cap that sleeps until the
+// next frame is due, and spins only through the last millisecond, the swap
+// interval, and a wait for input used by the idle mode. Also splits the CPU
+// and GPU time used between active and idle frames, to tell what idling
+// saves. Browsers pace the frames themselves, so on the web the cap and the
+// wait do nothing
+class FramePacer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class VSync { Off, On, Adaptive };
+
+  // Sets the swap interval of the current context. Adaptive vsync swaps
+  // late frames at once instead of waiting for the next refresh; drivers
+  // without it fall back to On. Returns the mode in effect
+  VSync setVSync(VSync mode);
+  [[nodiscard]] VSync vSync() const { return m_vSync; }
+
+  // 0 lifts the cap
+  void setMaxFps(int fps);
+  [[nodiscard]] int maxFps() const { return m_maxFps; }
+
+  // Returns when the next frame under the cap is due. Call once per frame
+  void pace();
+
+  // Returns when an event is pending, or after timeout seconds
+  static void waitForEvent(double timeout);
+
+  struct Usage {
+    double wall{};
+    double cpu{};
+    double gpu{};
+  };
+
+  // Adds the time since the last call to the active or idle usage. gpu is
+  // the total GPU time measured so far
+  void account(bool idle, double gpu);
+  [[nodiscard]] const Usage &active() const { return m_active; }
+  [[nodiscard]] const Usage &idle() const { return m_idle; }
+
+ private:
+  VSync m_vSync{VSync::Off};
+  int m_maxFps{};
+  Clock::time_point m_nextFrame{};
+
+  Usage m_active;
+  Usage m_idle;
+  Clock::time_point m_lastWall{Clock::now()};
+  std::clock_t m_lastCpu{std::clock()};
+  double m_lastGpu{};
+};
+
+#endif
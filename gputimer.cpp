@@ -0,0 +1,70 @@
+#include "gputimer.hpp"
+
+void GpuTimer::initializeGL() {
+#if !defined(__EMSCRIPTEN__)
+  for (auto &query : m_queries) {
+    abcg::glGenQueries(1, &query.m_id);
+    query.m_pending = false;
+  }
+  m_next = 0;
+  m_oldest = 0;
+  m_active = false;
+#endif
+}
+
+void GpuTimer::terminateGL() {
+#if !defined(__EMSCRIPTEN__)
+  for (auto &query : m_queries) {
+    abcg::glDeleteQueries(1, &query.m_id);
+  }
+#endif
+}
+
+// Skips the pass instead of waiting when every query is still in flight
+void GpuTimer::begin(Profiler::Stage stage) {
+#if !defined(__EMSCRIPTEN__)
+  auto &query{m_queries.at(m_next)};
+  if (query.m_id == 0 || query.m_pending) return;
+
+  query.m_stage = stage;
+  query.m_issued = Profiler::Clock::now();
+  abcg::glBeginQuery(GL_TIME_ELAPSED, query.m_id);
+  m_active = true;
+#else
+  (void)stage;
+#endif
+}
+
+void GpuTimer::end() {
+#if !defined(__EMSCRIPTEN__)
+  if (!m_active) return;
+
+  abcg::glEndQuery(GL_TIME_ELAPSED);
+  m_queries.at(m_next).m_pending = true;
+  m_next = (m_next + 1) % m_queries.size();
+  m_active = false;
+#endif
+}
+
+void GpuTimer::collect(Profiler &profiler) {
+#if !defined(__EMSCRIPTEN__)
+  while (m_queries.at(m_oldest).m_pending) {
+    auto &query{m_queries.at(m_oldest)};
+
+    GLuint available{};
+    abcg::glGetQueryObjectuiv(query.m_id, GL_QUERY_RESULT_AVAILABLE,
+                              &available);
+    if (available == GL_FALSE) break;
+
+    GLuint64 nanoseconds{};
+    abcg::glGetQueryObjectui64v(query.m_id, GL_QUERY_RESULT, &nanoseconds);
+    profiler.add(query.m_stage, query.m_issued,
+                 static_cast<double>(nanoseconds) * 1e-9);
+
+    query.m_pending = false;
+    m_oldest = (m_oldest + 1) % m_queries.size();
+  }
+#else
+  (void)profiler;
+#endif
+}
@@ -0,0 +1,38 @@
+#ifndef GPUTIMER_HPP_
+#define GPUTIMER_HPP_
+
+#include <array>
+
+#include "abcg.hpp"
+#include "profiler.hpp"
+
+// GL_TIME_ELAPSED queries around draw passes. Results are read a few frames
+// later, once available, so timing never stalls the pipeline. Not available
+// on WebGL, where begin() and end() do nothing
+class GpuTimer {
+ public:
+  void initializeGL();
+  void terminateGL();
+
+  // Passes cannot nest
+  void begin(Profiler::Stage stage);
+  void end();
+
+  // Adds every finished pass to the profiler's current frame
+  void collect(Profiler &profiler);
+
+ private:
+  struct Query {
+    GLuint m_id{};
+    Profiler::Stage m_stage{};
+    Profiler::Clock::time_point m_issued;
+    bool m_pending{};
+  };
+
+  std::array<Query, 16> m_queries{};
+  std::size_t m_next{};
+  std::size_t m_oldest{};
+  bool m_active{};
+};
+
+#endif
@@ -0,0 +1,554 @@
+#include "headless.hpp"
+
+#include <fmt/core.h>
+
+#include <bitset>
+#include <chrono>
+#include <cppitertools/itertools.hpp>
+#include <cstdint>
+#include <fstream>
+#include <glm/geometric.hpp>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "inputlog.hpp"
+#include "philox.hpp"
+#include "sessions.hpp"
+#include "snapshot.hpp"
+#include "softwarerenderer.hpp"
+#include "world.hpp"
+
+namespace {
+
+// The whole of text as a T. std::stoi and its kin only name themselves when
+// text is not a number, and ignore whatever follows one
+template <typename T>
+T parseNumber(std::string_view option, const std::string &text) {
+  try {
+    std::size_t end{};
+    T result{};
+    if constexpr (std::is_same_v<T, float>) {
+      result = std::stof(text, &end);
+    } else if constexpr (std::is_same_v<T, long>) {
+      result = std::stol(text, &end);
+    } else if constexpr (std::is_same_v<T, unsigned long>) {
+      result = std::stoul(text, &end);
+    } else {
+      result = std::stoi(text, &end);
+    }
+    if (end == text.size()) return result;
+  } catch (const std::logic_error &) {
+  }
+  throw std::invalid_argument{
+      fmt::format("{} needs a number, not {}", option, text)};
+}
+
+// Peak resident set size in KiB, or -1 where it is not available
+long peakMemoryKiB() {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
+// Binary PPM, which drops the alpha
+void writeImage(const std::string &path, const SoftwareRenderer &renderer,
+                std::span<const SoftwareRenderer::Pixel> frame) {
+  std::ofstream stream{path, std::ios::binary};
+  stream << fmt::format("P6\n{} {}\n255\n", renderer.width(),
+                        renderer.height());
+  std::vector<char> bytes;
+  bytes.reserve(frame.size() * 3);
+  for (const auto pixel : frame) {
+    for (const auto shift : {0U, 8U, 16U}) {
+      bytes.push_back(static_cast<char>((pixel >> shift) & 0xFFU));
+    }
+  }
+  stream.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  if (!stream) {
+    throw std::runtime_error{fmt::format("Cannot write {}", path)};
+  }
+}
+
+struct Run {
+  double seconds{};
+  World::StageTimes stages;
+  std::uint64_t checksum{};
+  std::size_t items{};
+  int objects{};
+  Items::PoolStats pool;
+  long allocatingTicks{};
+  int rounds{};
+  double loadSeconds{};
+};
+
+// Replays the input of log tick by tick, if given
+Run simulate(const HeadlessOptions &options, int threads,
+             const InputLog *log) {
+  World world;
+  world.setThreads(threads);
+  double loadSeconds{};
+  if (!options.snapshot.empty()) {
+    const auto start{std::chrono::steady_clock::now()};
+    const auto checksum{Snapshot::load(world, options.snapshot)};
+    loadSeconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    if (world.checksum() != checksum) {
+      throw std::runtime_error{fmt::format(
+          "{} does not load to the state it was saved in", options.snapshot)};
+    }
+  } else {
+    world.setMeshSeed(options.seed);
+    world.restart(options.items, options.seed);
+  }
+  if (options.cluster > 0.0f) world.clusterItems(options.cluster);
+
+  const auto tick{1.0f / options.tickRate};
+  const auto start{std::chrono::steady_clock::now()};
+  long allocatingTicks{};
+  for (long index = 0; index < options.ticks; ++index) {
+    if (log != nullptr) {
+      world.setInput(log->m_inputs[static_cast<std::size_t>(index)]);
+    }
+    world.step(tick);
+    if (world.stepAllocations() > 0) ++allocatingTicks;
+  }
+  const std::chrono::duration<double> elapsed{
+      std::chrono::steady_clock::now() - start};
+
+  if (!options.saveSnapshot.empty()) {
+    Snapshot::save(world, options.saveSnapshot);
+  }
+  if (!options.capture.empty()) {
+    SoftwareRenderer renderer;
+    renderer.initialize(600, 600, world.meshSeed());
+    std::vector<SoftwareRenderer::Pixel> frame(renderer.frameSize());
+    std::vector<std::size_t> order;
+    renderer.render(world, frame, order);
+    writeImage(options.capture, renderer, frame);
+  }
+  return {elapsed.count(), world.stageTimes(), world.checksum(),
+          world.items().size(), world.objects(), world.items().poolStats(),
+          allocatingTicks, world.rounds(), loadSeconds};
+}
+
+// The random draws of spawning options.items items: the per-item
+// std::default_random_engine path that Items used to take, building its
+// distributions for every item, against batched Philox fills, serial and on
+// options.threads threads
+int benchmarkRandom(const HeadlessOptions &options) {
+  const auto count{static_cast<std::size_t>(options.items)};
+  // Spawn position, sides, angular velocity, direction, variant
+  const auto valuesPerItem{7.0};
+  using Clock = std::chrono::steady_clock;
+  const auto show{[&](const char *name, Clock::time_point start,
+                        double sink) {
+    const std::chrono::duration<double> elapsed{Clock::now() - start};
+    fmt::print("{:<22}{:>10.3f} ms{:>10.2f} ns/item{:>10.0f} M values/s  "
+               "({:.3g})\n",
+               name, elapsed.count() * 1e3,
+               count > 0 ? elapsed.count() * 1e9 / count : 0.0,
+               elapsed.count() > 0.0
+                   ? valuesPerItem * count / elapsed.count() * 1e-6
+                   : 0.0,
+               sink);
+  }};
+
+  fmt::print("random draws for {} items, seed {}\n", count, options.seed);
+
+  {
+    const auto start{Clock::now()};
+    std::default_random_engine engine{options.seed};
+    std::uniform_real_distribution<float> dist{-1.0f, 1.0f};
+    auto sink{0.0};
+    for ([[maybe_unused]] auto index : iter::range(count)) {
+      glm::vec2 translation{};
+      do {
+        translation = {dist(engine), dist(engine)};
+      } while (glm::length(translation) < 0.5f);
+      std::uniform_int_distribution<int> randomSides(Items::minSides,
+                                                     Items::maxSides);
+      std::uniform_int_distribution<int> randomVariant(
+          0, Items::meshVariants - 1);
+      sink += translation.x + randomSides(engine) + dist(engine) +
+              dist(engine) + dist(engine) + randomVariant(engine);
+    }
+    show("std, per item", start, sink);
+  }
+
+  std::vector<float> floats(5 * count);
+  std::vector<int> ints(2 * count);
+  {
+    const auto start{Clock::now()};
+    Philox random{options.seed};
+    const std::span all{floats};
+    random.fillUniform(all.first(2 * count), -1.0f, 1.0f);
+    random.fillUniformInt(std::span{ints}.first(count), Items::minSides,
+                          Items::maxSides);
+    random.fillUniformInt(std::span{ints}.last(count), 0,
+                          Items::meshVariants - 1);
+    random.fillUniform(all.last(3 * count), -1.0f, 1.0f);
+    show("philox, batched", start, floats.back() + ints.back());
+  }
+
+  if (options.threads > 1) {
+    // Each chunk of items fills its own part of every array, at the
+    // positions the serial fills above read
+    ThreadPool pool{options.threads};
+    std::vector<float> parallelFloats(floats.size());
+    std::vector<int> parallelInts(ints.size());
+    const auto start{Clock::now()};
+    const Philox random{options.seed};
+    pool.parallelFor(count, 16384, [&](auto, auto begin, auto end) {
+      const auto items{end - begin};
+      const std::span out{parallelFloats};
+      const std::span outInts{parallelInts};
+      random.fillUniformAt(2 * begin, out.subspan(2 * begin, 2 * items),
+                           -1.0f, 1.0f);
+      random.fillUniformIntAt(2 * count + begin, outInts.subspan(begin, items),
+                              Items::minSides, Items::maxSides);
+      random.fillUniformIntAt(3 * count + begin,
+                              outInts.subspan(count + begin, items), 0,
+                              Items::meshVariants - 1);
+      random.fillUniformAt(4 * count + 3 * begin,
+                           out.subspan(2 * count + 3 * begin, 3 * items),
+                           -1.0f, 1.0f);
+    });
+    show(fmt::format("philox, {} threads", options.threads).c_str(), start,
+           parallelFloats.back() + parallelInts.back());
+
+    const auto same{parallelFloats == floats && parallelInts == ints};
+    fmt::print("same values as the serial fill: {}\n", same ? "yes" : "NO");
+    if (!same) return -1;
+  }
+  return 0;
+}
+
+// Every session holds Up and steers by a pattern of its own
+std::uint8_t botInput(std::size_t session, long tick) {
+  std::bitset<4> input;
+  input.set(static_cast<std::size_t>(Input::Up));
+  switch ((static_cast<std::size_t>(tick / 30) + session) % 3) {
+    case 1:
+      input.set(static_cast<std::size_t>(Input::Left));
+      break;
+    case 2:
+      input.set(static_cast<std::size_t>(Input::Right));
+      break;
+    default:
+      break;
+  }
+  return static_cast<std::uint8_t>(input.to_ulong());
+}
+
+int benchmarkSessions(const HeadlessOptions &options) {
+  fmt::print("sessions of {} items, {} ticks at {} Hz, seed {}, {} "
+             "thread(s)\n",
+             options.items, options.ticks, options.tickRate, options.seed,
+             options.threads);
+  // Rounds that ended, and the mean score of the last round of each session
+  fmt::print("{:>10}{:>12}{:>16}{:>10}{:>12}\n", "sessions", "seconds",
+             "steps/s", "rounds", "avg score");
+
+  Sessions sessions;
+  std::vector<std::uint8_t> inputs;
+  const auto tick{1.0f / options.tickRate};
+  const auto run{[&](std::size_t count, int threads) {
+    sessions.setThreads(threads);
+    sessions.reset(count, options.items, options.seed);
+    inputs.resize(count);
+
+    long rounds{};
+    const auto start{std::chrono::steady_clock::now()};
+    for (long index = 0; index < options.ticks; ++index) {
+      for (auto session : iter::range(count)) {
+        inputs[session] = botInput(session, index);
+      }
+      sessions.step(inputs, tick);
+      for (const auto &transition : sessions.transitions()) {
+        if (transition.state == State::Win) ++rounds;
+      }
+    }
+    const std::chrono::duration<double> elapsed{
+        std::chrono::steady_clock::now() - start};
+
+    const auto steps{static_cast<double>(count) *
+                     static_cast<double>(options.ticks)};
+    const auto &scores{sessions.scores()};
+    const auto score{static_cast<double>(
+                         std::accumulate(scores.begin(), scores.end(), 0L)) /
+                     static_cast<double>(count)};
+    fmt::print("{:>10}{:>12.3f}{:>16.0f}{:>10}{:>12.1f}\n", count,
+               elapsed.count(),
+               elapsed.count() > 0.0 ? steps / elapsed.count() : 0.0, rounds,
+               score);
+    return sessions.checksum();
+  }};
+
+  const auto total{static_cast<std::size_t>(options.sessions)};
+  for (std::size_t count = 1; count < total; count *= 4) {
+    run(count, options.threads);
+  }
+  const auto checksum{run(total, options.threads)};
+
+  if (options.threads > 1) {
+    fmt::print("one thread:\n");
+    const auto same{run(total, 1) == checksum};
+    fmt::print("same results as one thread: {}\n", same ? "yes" : "NO");
+    if (!same) return -1;
+  }
+  return 0;
+}
+
+// One World stepped and drawn tick by tick at two sizes, then a batch of
+// sessions drawn together at the small one
+int benchmarkRaster(const HeadlessOptions &options) {
+  fmt::print("software rendering of {} items, {} frames, seed {}, {} "
+             "thread(s)\n",
+             options.items, options.ticks, options.seed, options.threads);
+  fmt::print("{:>10}{:>10}{:>12}{:>12}{:>16}\n", "size", "sessions",
+             "seconds", "frames/s", "frames/s/core");
+
+  const auto tick{1.0f / options.tickRate};
+  const auto show{[&](int size, std::size_t sessions, int threads,
+                      double seconds) {
+    const auto frames{static_cast<double>(sessions) *
+                      static_cast<double>(options.ticks)};
+    const auto rate{seconds > 0.0 ? frames / seconds : 0.0};
+    fmt::print("{:>10}{:>10}{:>12.3f}{:>12.0f}{:>16.0f}\n",
+               fmt::format("{}x{}", size, size), sessions, seconds, rate,
+               rate / threads);
+  }};
+
+  for (const auto size : {84, 600}) {
+    SoftwareRenderer renderer;
+    renderer.initialize(size, size, options.seed);
+    std::vector<SoftwareRenderer::Pixel> frame(renderer.frameSize());
+    std::vector<std::size_t> order;
+    World world;
+    world.restart(options.items, options.seed);
+
+    std::chrono::duration<double> elapsed{};
+    for (long index = 0; index < options.ticks; ++index) {
+      world.setInput(botInput(0, index));
+      world.step(tick);
+      const auto start{std::chrono::steady_clock::now()};
+      renderer.render(world, frame, order);
+      elapsed += std::chrono::steady_clock::now() - start;
+    }
+    show(size, 1, 1, elapsed.count());
+  }
+
+  const auto count{
+      static_cast<std::size_t>(options.sessions > 0 ? options.sessions : 64)};
+  SoftwareRenderer renderer;
+  renderer.initialize(84, 84, options.seed);
+  std::vector<SoftwareRenderer::Pixel> frames(renderer.frameSize() * count);
+  ThreadPool pool{options.threads};
+  Sessions sessions;
+  sessions.setThreads(options.threads);
+  sessions.reset(count, options.items, options.seed);
+  std::vector<std::uint8_t> inputs(count);
+
+  std::chrono::duration<double> elapsed{};
+  for (long index = 0; index < options.ticks; ++index) {
+    for (auto session : iter::range(count)) {
+      inputs[session] = botInput(session, index);
+    }
+    sessions.step(inputs, tick);
+    const auto start{std::chrono::steady_clock::now()};
+    renderer.render(sessions, frames, pool);
+    elapsed += std::chrono::steady_clock::now() - start;
+  }
+  show(84, count, options.threads, elapsed.count());
+  return 0;
+}
+
+void report(const HeadlessOptions &options, int threads, const Run &run) {
+  const auto ticks{static_cast<double>(options.ticks)};
+  fmt::print("\n{} thread(s): {} ticks in {:.3f} s, {:.0f} ticks/s\n", threads,
+             options.ticks, run.seconds,
+             run.seconds > 0.0 ? ticks / run.seconds : 0.0);
+
+  const auto perTick{[&](double total) {
+    return options.ticks > 0 ? total * 1e6 / ticks : 0.0;
+  }};
+  fmt::print("{:<14}{:>12}{:>12}\n", "stage", "total ms", "us/tick");
+  for (const auto &[name, total] :
+       {std::pair{"car", run.stages.car}, std::pair{"items", run.stages.items},
+        std::pair{"collisions", run.stages.collisions},
+        std::pair{"win condition", run.stages.winCondition}}) {
+    fmt::print("{:<14}{:>12.3f}{:>12.3f}\n", name, total * 1e3,
+               perTick(total));
+  }
+
+  fmt::print("{} items left, {} collected in the last round\n", run.items,
+             run.objects);
+  fmt::print("{} round(s), restart {:.3f} ms on average\n", run.rounds,
+             run.rounds > 0 ? run.stages.restart * 1e3 / run.rounds : 0.0);
+  fmt::print("item pool: capacity {}, peak {}, {} allocations, in {} of {} "
+             "ticks\n",
+             run.pool.capacity, run.pool.highWater, run.pool.allocations,
+             run.allocatingTicks, options.ticks);
+  if (!options.snapshot.empty()) {
+    fmt::print("snapshot loaded in {:.3f} ms\n", run.loadSeconds * 1e3);
+  }
+}
+
+}  // namespace
+
+std::optional<HeadlessOptions> parseHeadlessOptions(int argc, char **argv) {
+  auto headless{false};
+  std::string_view unknown;
+  HeadlessOptions options;
+  options.seed = static_cast<unsigned int>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+
+  for (int index = 1; index < argc; ++index) {
+    const std::string_view argument{argv[index]};
+    const auto value{[&]() -> std::string {
+      if (index + 1 >= argc) {
+        throw std::invalid_argument{fmt::format("{} needs a value", argument)};
+      }
+      return argv[++index];
+    }};
+
+    if (argument == "--headless") {
+      headless = true;
+    } else if (argument == "--items") {
+      options.items = parseNumber<int>(argument, value());
+    } else if (argument == "--ticks") {
+      options.ticks = parseNumber<long>(argument, value());
+    } else if (argument == "--seed") {
+      options.seed = static_cast<unsigned int>(
+          parseNumber<unsigned long>(argument, value()));
+    } else if (argument == "--tick-rate") {
+      options.tickRate = parseNumber<float>(argument, value());
+    } else if (argument == "--threads") {
+      options.threads = parseNumber<int>(argument, value());
+    } else if (argument == "--replay") {
+      options.replay = value();
+    } else if (argument == "--snapshot") {
+      options.snapshot = value();
+    } else if (argument == "--cluster") {
+      options.cluster = parseNumber<float>(argument, value());
+    } else if (argument == "--save-snapshot") {
+      options.saveSnapshot = value();
+    } else if (argument == "--sessions") {
+      options.sessions = parseNumber<int>(argument, value());
+    } else if (argument == "--capture") {
+      options.capture = value();
+    } else if (argument == "--bench-raster") {
+      options.benchRaster = true;
+    } else if (argument == "--bench-random") {
+      options.benchRandom = true;
+    } else if (argument == "--fps" || argument == "--vsync" ||
+               argument == "--record") {
+      // Window options, ignored here along with their values
+      (void)value();
+    } else if (argument != "--no-idle" && argument != "--no-sim-thread" &&
+               unknown.empty()) {
+      unknown = argument;
+    }
+  }
+
+  if (!headless) return std::nullopt;
+  // A misspelled option would otherwise run with its default
+  if (!unknown.empty()) {
+    throw std::invalid_argument{fmt::format("Unknown option {}", unknown)};
+  }
+  return options;
+}
+
+int runHeadless(HeadlessOptions options) {
+  std::optional<InputLog> log;
+  if (!options.replay.empty()) {
+    log = InputLog::load(options.replay);
+    options.items = log->m_items;
+    options.seed = log->m_seed;
+    options.tickRate = log->m_tickRate;
+    options.ticks = static_cast<long>(log->m_inputs.size());
+  }
+
+  if (options.items < 0 || options.ticks < 0) {
+    throw std::invalid_argument{"--items and --ticks must not be negative"};
+  }
+  if (options.tickRate <= 0.0f || options.threads < 1) {
+    throw std::invalid_argument{"--tick-rate and --threads must be positive"};
+  }
+
+  if (!options.replay.empty() && !options.snapshot.empty()) {
+    throw std::invalid_argument{"--replay and --snapshot cannot be combined"};
+  }
+
+  if (options.benchRandom) return benchmarkRandom(options);
+  if (options.sessions < 0) {
+    throw std::invalid_argument{"--sessions must not be negative"};
+  }
+  if (options.benchRaster) return benchmarkRaster(options);
+  if (options.sessions > 0) return benchmarkSessions(options);
+
+  if (options.snapshot.empty()) {
+    fmt::print("items {}, ticks {} at {} Hz, seed {}\n", options.items,
+               options.ticks, options.tickRate, options.seed);
+  } else {
+    fmt::print("snapshot {}, ticks {} at {} Hz\n", options.snapshot,
+               options.ticks, options.tickRate);
+  }
+
+  std::optional<Run> serial;
+  if (options.threads > 1) {
+    serial = simulate(options, 1, log ? &*log : nullptr);
+    report(options, 1, *serial);
+  }
+
+  const auto run{
+      simulate(options, options.threads, log ? &*log : nullptr)};
+  report(options, options.threads, run);
+
+  if (serial) {
+    // A stage that took no time, as with --ticks 0, has no speedup
+    const auto speedup{[](double serialSeconds, double seconds) {
+      return seconds > 0.0 ? fmt::format("{:.2f}x", serialSeconds / seconds)
+                           : std::string{"n/a"};
+    }};
+    fmt::print("\nspeedup over serial: {} (items {}, collisions {}), same "
+               "final state: {}\n",
+               speedup(serial->seconds, run.seconds),
+               speedup(serial->stages.items, run.stages.items),
+               speedup(serial->stages.collisions, run.stages.collisions),
+               serial->checksum == run.checksum ? "yes" : "NO");
+  }
+
+  if (const auto peak{peakMemoryKiB()}; peak >= 0) {
+    fmt::print("peak memory {:.1f} MiB\n", static_cast<double>(peak) / 1024.0);
+  } else {
+    fmt::print("peak memory unavailable\n");
+  }
+
+  if (log) {
+    fmt::print("same final state as the recording: {}\n",
+               run.checksum == log->m_checksum ? "yes" : "NO");
+    if (run.checksum != log->m_checksum) return -1;
+  }
+
+  return serial && serial->checksum != run.checksum ? -1 : 0;
+}
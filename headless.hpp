@@ -0,0 +1,46 @@
+#ifndef HEADLESS_HPP_
+#define HEADLESS_HPP_
+
+#include <optional>
+#include <string>
+
+// Runs the World without a window or GL context, for load tests and CI:
+//   car --headless [--items N] [--ticks T] [--seed S] [--tick-rate HZ]
+//                  [--threads N] [--replay FILE | --snapshot FILE]
+//                  [--cluster R] [--save-snapshot FILE] [--bench-random]
+//                  [--sessions N] [--capture FILE] [--bench-raster]
+// With more than one thread, the same run is also done serially first to
+// report the speedup and check that both give the same state. --replay
+// takes the seed, items, tick rate, ticks and input from a recorded
+// InputLog, and checks that the run ends in the recorded state.
+// --snapshot starts from a saved World instead of a new round, --cluster
+// first crowds the items around the car within R, and --save-snapshot
+// stores the state the run ends in (with --ticks 0, the one it starts from).
+// --bench-random only times the random draws of spawning the items.
+// --sessions runs N independent games together instead of one, and every
+// power of 4 below N, to report how the steps per second scale.
+// --capture draws the state the run ends in on the CPU, as a 600x600 PPM
+// image. --bench-raster times that drawing, one World at 84x84 and 600x600,
+// then a batch of --sessions games (64 by default) at 84x84
+struct HeadlessOptions {
+  int items{100};
+  long ticks{600};
+  unsigned int seed{};
+  float tickRate{60.0f};
+  int threads{1};
+  std::string replay;
+  std::string snapshot;
+  float cluster{};
+  std::string saveSnapshot;
+  bool benchRandom{};
+  int sessions{};
+  std::string capture;
+  bool benchRaster{};
+};
+
+// Returns nothing unless --headless is among the arguments
+std::optional<HeadlessOptions> parseHeadlessOptions(int argc, char **argv);
+
+int runHeadless(HeadlessOptions options);
+
+#endif
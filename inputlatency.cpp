@@ -0,0 +1,23 @@
+#include "inputlatency.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+void InputLatency::pressPainted(Clock::time_point press,
+                                Clock::time_point now) {
+  const std::chrono::duration<float, std::milli> latency{now - press};
+  m_latencies.at(m_presses % window) = latency.count();
+  ++m_presses;
+}
+
+InputLatency::Summary InputLatency::summary() const {
+  if (m_presses == 0) return {};
+
+  const auto count{std::min(m_presses, window)};
+  const auto begin{m_latencies.begin()};
+  const auto end{begin + static_cast<std::ptrdiff_t>(count)};
+  return {m_latencies.at((m_presses - 1) % window),
+          std::accumulate(begin, end, 0.0) / static_cast<double>(count),
+          *std::max_element(begin, end), m_presses};
+}
@@ -0,0 +1,33 @@
+#ifndef INPUTLATENCY_HPP_
+#define INPUTLATENCY_HPP_
+
+#include <array>
+#include <cstddef>
+
+#include "profiler.hpp"
+
+// Latency from a press to the end of the first frame that drew a tick that
+// simulated it, over the last few presses
+class InputLatency {
+ public:
+  using Clock = Profiler::Clock;
+
+  void pressPainted(Clock::time_point press, Clock::time_point now);
+
+  // Over the last window presses, in milliseconds
+  struct Summary {
+    double last{};
+    double avg{};
+    double max{};
+    std::size_t presses{};
+  };
+  [[nodiscard]] Summary summary() const;
+
+ private:
+  static constexpr std::size_t window{64};
+
+  std::array<float, window> m_latencies{};
+  std::size_t m_presses{};
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "inputlog.hpp"
+
+#include <fmt/core.h>
+
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// Bumped whenever the same seed and input stop giving the same run
+constexpr std::string_view magic{"CARLOG04"};
+
+template <typename T>
+void write(std::ofstream &stream, T value) {
+  stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T read(std::ifstream &stream) {
+  T value{};
+  stream.read(reinterpret_cast<char *>(&value), sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+void InputLog::save(const std::string &path) const {
+  std::ofstream stream{path, std::ios::binary};
+  if (!stream) {
+    throw std::runtime_error{fmt::format("Cannot write {}", path)};
+  }
+
+  stream.write(magic.data(), static_cast<std::streamsize>(magic.size()));
+  write(stream, static_cast<std::uint32_t>(m_seed));
+  write(stream, static_cast<std::int32_t>(m_items));
+  write(stream, m_tickRate);
+  write(stream, static_cast<std::uint64_t>(m_inputs.size()));
+  write(stream, m_checksum);
+
+  for (std::size_t index = 0; index < m_inputs.size();) {
+    std::uint32_t run{1};
+    while (index + run < m_inputs.size() &&
+           m_inputs[index + run] == m_inputs[index] && run < UINT32_MAX) {
+      ++run;
+    }
+    write(stream, m_inputs[index]);
+    write(stream, run);
+    index += run;
+  }
+
+  if (!stream) {
+    throw std::runtime_error{fmt::format("Cannot write {}", path)};
+  }
+}
+
+InputLog InputLog::load(const std::string &path) {
+  std::ifstream stream{path, std::ios::binary};
+  if (!stream) {
+    throw std::runtime_error{fmt::format("Cannot open {}", path)};
+  }
+
+  std::string header(magic.size(), '\0');
+  stream.read(header.data(), static_cast<std::streamsize>(header.size()));
+  if (!stream || header != magic) {
+    throw std::runtime_error{fmt::format("{} is not an input log", path)};
+  }
+
+  InputLog log;
+  log.m_seed = read<std::uint32_t>(stream);
+  log.m_items = read<std::int32_t>(stream);
+  log.m_tickRate = read<float>(stream);
+  const auto ticks{read<std::uint64_t>(stream)};
+  log.m_checksum = read<std::uint64_t>(stream);
+  const auto corrupt{[&path] {
+    return std::runtime_error{
+        fmt::format("{} is truncated or corrupt", path)};
+  }};
+  if (!stream || log.m_items < 0 || !std::isfinite(log.m_tickRate) ||
+      log.m_tickRate <= 0.0f) {
+    throw corrupt();
+  }
+
+  // Not reserved up front: the tick count is only trusted once the runs
+  // add up to it
+  while (stream && log.m_inputs.size() < ticks) {
+    const auto input{read<std::uint8_t>(stream)};
+    const auto run{read<std::uint32_t>(stream)};
+    if (!stream || run > ticks - log.m_inputs.size()) break;
+    log.m_inputs.insert(log.m_inputs.end(), run, input);
+  }
+
+  if (log.m_inputs.size() != ticks) throw corrupt();
+  return log;
+}
+
+InputLogOptions parseInputLogOptions(int argc, char **argv) {
+  InputLogOptions options;
+  for (int index = 1; index < argc; ++index) {
+    const std::string_view argument{argv[index]};
+    if (argument != "--record" && argument != "--replay") continue;
+
+    if (index + 1 >= argc) {
+      throw std::invalid_argument{fmt::format("{} needs a value", argument)};
+    }
+    (argument == "--record" ? options.record : options.replay) =
+        argv[++index];
+  }
+
+  if (!options.record.empty() && !options.replay.empty()) {
+    throw std::invalid_argument{"--record and --replay cannot be combined"};
+  }
+  return options;
+}
@@ -0,0 +1,34 @@
+#ifndef INPUTLOG_HPP_
+#define INPUTLOG_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Everything needed to replay a session tick by tick: the World's seed,
+// item count and tick rate, and GameData::m_input at every tick. The final
+// World::checksum() tells whether a replay reached the same state
+//
+// On disk: "CARLOG04", seed, items, tick rate, tick count, checksum, then
+// the inputs as (input, run length) pairs, all little-endian
+struct InputLog {
+  unsigned int m_seed{};
+  int m_items{100};
+  float m_tickRate{60.0f};
+  std::vector<std::uint8_t> m_inputs;
+  std::uint64_t m_checksum{};
+
+  // Throw std::runtime_error if the file cannot be written or read
+  void save(const std::string &path) const;
+  static InputLog load(const std::string &path);
+};
+
+// Input log options of the window mode: [--record FILE | --replay FILE]
+struct InputLogOptions {
+  std::string record;
+  std::string replay;
+};
+
+InputLogOptions parseInputLogOptions(int argc, char **argv);
+
+#endif
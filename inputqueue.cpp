@@ -0,0 +1,49 @@
+#include "inputqueue.hpp"
+
+#include <algorithm>
+
+// Stamps have a millisecond resolution, so an event can seem to come just
+// before the one pushed earlier
+void InputQueue::push(const Event &event) {
+  m_events.push_back(event);
+  if (m_events.size() > 1) {
+    auto &time{m_events.back().m_time};
+    time = std::max(time, m_events[m_events.size() - 2].m_time);
+  }
+}
+
+std::bitset<4> InputQueue::tick(Clock::time_point end) {
+  auto input{m_held};
+  while (!m_events.empty() && m_events.front().m_time <= end) {
+    const auto &event{m_events.front()};
+    const auto bit{static_cast<std::size_t>(event.m_input)};
+    if (event.m_pressed) {
+      // Key repeats and presses of held keys do not start a new latency
+      if (!m_held[bit]) m_consumed.push_back(event.m_time);
+      m_held.set(bit);
+      input.set(bit);
+    } else {
+      m_held.reset(bit);
+    }
+    m_events.pop_front();
+  }
+  return input;
+}
+
+void InputQueue::reconcile(std::bitset<4> held, Clock::time_point time) {
+  auto queued{m_held};
+  for (const auto &event : m_events) {
+    queued.set(static_cast<std::size_t>(event.m_input), event.m_pressed);
+  }
+  for (std::size_t bit{}; bit < held.size(); ++bit) {
+    if (queued[bit] != held[bit]) {
+      push({time, static_cast<Input>(bit), held[bit]});
+    }
+  }
+}
+
+void InputQueue::clear() {
+  m_events.clear();
+  m_held.reset();
+  m_consumed.clear();
+}
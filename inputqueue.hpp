@@ -0,0 +1,53 @@
+#ifndef INPUTQUEUE_HPP_
+#define INPUTQUEUE_HPP_
+
+#include <bitset>
+#include <deque>
+#include <span>
+#include <vector>
+
+#include "gamedata.hpp"
+#include "profiler.hpp"
+
+// Presses and releases with the time they happened, consumed by the
+// simulation tick whose time span holds them instead of sampled once per
+// frame. The presses consumed are kept for InputLatency
+class InputQueue {
+ public:
+  using Clock = Profiler::Clock;
+
+  struct Event {
+    Clock::time_point m_time;
+    Input m_input{};
+    bool m_pressed{};
+  };
+
+  // Events are kept in the order they are pushed
+  void push(const Event &event);
+
+  // Input of the tick that ends at end: what was held when it started, plus
+  // every press up to end, even one released again before end, so that taps
+  // shorter than a tick still last one tick
+  [[nodiscard]] std::bitset<4> tick(Clock::time_point end);
+  // Input held after the last tick
+  [[nodiscard]] std::bitset<4> held() const { return m_held; }
+
+  // Pushes, at time, the presses and releases that make the input held
+  // after every queued event match held. Makes up for lost events
+  void reconcile(std::bitset<4> held, Clock::time_point time);
+
+  // Times of the presses consumed by tick() since clearConsumed()
+  [[nodiscard]] std::span<const Clock::time_point> consumed() const {
+    return m_consumed;
+  }
+  void clearConsumed() { m_consumed.clear(); }
+
+  void clear();
+
+ private:
+  std::deque<Event> m_events;
+  std::bitset<4> m_held;
+  std::vector<Clock::time_point> m_consumed;
+};
+
+#endif
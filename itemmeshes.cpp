@@ -0,0 +1,37 @@
+#include "itemmeshes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <span>
+
+#include "philox.hpp"
+
+void ItemMeshes::create(unsigned int seed) {
+  Philox random{seed};
+
+  m_positions.clear();
+  m_maxCount = 0;
+  std::array<float, Items::maxSides> radii{};
+  for (auto mesh : iter::range(Items::numMeshes)) {
+    const auto sides{Items::minSides + mesh / Items::meshVariants};
+    m_first.at(mesh) = static_cast<int>(m_positions.size());
+
+    const std::span meshRadii{radii.data(), static_cast<std::size_t>(sides)};
+    random.fillUniform(meshRadii, 0.8f, 1.0f);
+
+    const auto first{m_positions.size() + 1};
+    m_positions.emplace_back(0, 0);
+    const auto step{M_PI * 2 / sides};
+    for (auto vertex : iter::range(sides)) {
+      const auto angle{step * vertex};
+      const auto radius{meshRadii[vertex]};
+      m_positions.emplace_back(radius * std::cos(angle),
+                               radius * std::sin(angle));
+    }
+    m_positions.push_back(m_positions.at(first));
+
+    m_count.at(mesh) = static_cast<int>(m_positions.size()) - m_first.at(mesh);
+    m_maxCount = std::max(m_maxCount, m_count.at(mesh));
+  }
+}
@@ -0,0 +1,25 @@
+#ifndef ITEMMESHES_HPP_
+#define ITEMMESHES_HPP_
+
+#include <array>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "items.hpp"
+
+// Shapes of the items, shared by every renderer: for each side count,
+// Items::meshVariants triangle fans with different radius jitter, all in
+// one vertex array. A fan is its center, then its rim, closed by repeating
+// the first rim vertex. Radii are at most 1, in units of the item's scale
+struct ItemMeshes {
+  std::vector<glm::vec2> m_positions;
+  std::array<int, Items::numMeshes> m_first{};
+  std::array<int, Items::numMeshes> m_count{};
+  int m_maxCount{};
+
+  // The same seed gives the same shapes
+  void create(unsigned int seed);
+};
+
+#endif
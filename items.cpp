@@ -1,142 +1,257 @@
 #include "items.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <cppitertools/itertools.hpp>
+#include <cstddef>
+#include <functional>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtx/fast_trigonometry.hpp>
 
-void Items::initializeGL(GLuint program, int quantity) {
-  terminateGL();
+namespace {
 
-  
-  m_randomEngine.seed(
-      std::chrono::steady_clock::now().time_since_epoch().count());
+// Items have always been drawn black: the baseline sent a random gray to a
+// uniform the shader does not declare
+const glm::vec4 itemColor{0.0f, 0.0f, 0.0f, 1.0f};
+
+}  // namespace
 
-  m_program = program;
-  m_colorLoc = abcg::glGetUniformLocation(m_program, "color");
-  m_rotationLoc = abcg::glGetUniformLocation(m_program, "rotation");
-  m_scaleLoc = abcg::glGetUniformLocation(m_program, "scale");
-  m_translationLoc = abcg::glGetUniformLocation(m_program, "translation");
+void Items::reset(int quantity, unsigned int seed) {
+  
+  m_random.seed(seed);
 
   
-  m_items.clear();
-  m_items.resize(quantity);
+  m_translations.clear();
+  m_velocities.clear();
+  m_rotations.clear();
+  m_angularVelocities.clear();
+  m_scales.clear();
+  m_colors.clear();
+  m_meshes.clear();
+  m_alive.clear();
+  m_previousTranslations.clear();
+  m_previousRotations.clear();
+
+  // Clearing keeps the capacity, so restarting a round with the same number
+  // of items reuses the storage of the previous one
+  reserve(static_cast<std::size_t>(quantity));
+
+  // About four items per cell at the initial density
+  m_grid.reset(std::max(4, static_cast<int>(std::sqrt(quantity / 4.0))));
 
-  for (auto &item : m_items) {
-    item = createItem();
+  // Beyond 100 items they shrink, so that together they keep covering about
+  // the same area
+  const auto scale{
+      quantity > 100
+          ? maxScale * static_cast<float>(std::sqrt(100.0 / quantity))
+          : maxScale};
 
-    
-    do {
-      item.m_translation = {m_randomDist(m_randomEngine),
-                                m_randomDist(m_randomEngine)};
-    } while (glm::length(item.m_translation) < 0.5f);
+  // Spawn positions in one fill, redrawing the few that land too close to
+  // the car
+  const auto count{static_cast<std::size_t>(quantity)};
+  m_randomFloats.resize(2 * count);
+  m_random.fillUniform(m_randomFloats, -1.0f, 1.0f);
+  m_spawnTranslations.resize(count);
+  for (auto index : iter::range(count)) {
+    auto &translation{m_spawnTranslations[index]};
+    translation = {m_randomFloats[2 * index], m_randomFloats[2 * index + 1]};
+    while (glm::length(translation) < 0.5f) {
+      translation = {m_random.uniform(-1.0f, 1.0f),
+                     m_random.uniform(-1.0f, 1.0f)};
+    }
   }
+  createItems(m_spawnTranslations, scale);
 }
 
-void Items::paintGL() {
-  abcg::glUseProgram(m_program);
+// Both loops are branch-free so that the compiler can vectorize them, and
+// each pool chunk runs them over its own range of items
+void Items::update(const Car &car, float deltaTime, ThreadPool &pool) {
+  m_previousTranslations = m_translations;
+  m_previousRotations = m_rotations;
+
+  const auto carOffset{car.m_velocity * deltaTime};
+  const auto twoPi{glm::two_pi<float>()};
 
-  for (const auto &item : m_items) {
-    abcg::glBindVertexArray(item.m_vao);
+  pool.parallelFor(size(), 16384, [&](auto /*chunk*/, auto begin, auto end) {
+    auto *translations{m_translations.data()};
+    const auto *velocities{m_velocities.data()};
+    for (auto index{begin}; index < end; ++index) {
+      auto translation{translations[index] - carOffset +
+                       velocities[index] * deltaTime};
 
-    abcg::glUniform4fv(m_colorLoc, 1, &item.m_color.r);
-    abcg::glUniform1f(m_scaleLoc, item.m_scale);
-    abcg::glUniform1f(m_rotationLoc, item.m_rotation);
+      translation.x += 2.0f * static_cast<float>(translation.x < -1.0f) -
+                       2.0f * static_cast<float>(translation.x > +1.0f);
+      translation.y += 2.0f * static_cast<float>(translation.y < -1.0f) -
+                       2.0f * static_cast<float>(translation.y > +1.0f);
+      translations[index] = translation;
+    }
 
-    for (auto i : {-2, 0, 2}) {
-      for (auto j : {-2, 0, 2}) {
-        abcg::glUniform2f(m_translationLoc, item.m_translation.x + j,
-                          item.m_translation.y + i);
+    // Same as glm::wrapAngle, given that a step is smaller than a full turn
+    auto *rotations{m_rotations.data()};
+    const auto *angularVelocities{m_angularVelocities.data()};
+    for (auto index{begin}; index < end; ++index) {
+      auto rotation{rotations[index] + angularVelocities[index] * deltaTime};
 
-        abcg::glDrawArrays(GL_TRIANGLE_FAN, 0, item.m_polygonSides + 2);
-      }
+      rotation += twoPi * (static_cast<float>(rotation < 0.0f) -
+                           static_cast<float>(rotation >= twoPi));
+      rotations[index] = rotation;
     }
+  });
 
-    abcg::glBindVertexArray(0);
-  }
+  m_grid.update(m_translations, pool);
+}
+
+// FNV-1a over the item state, to compare runs
+std::uint64_t Items::checksum() const {
+  std::uint64_t hash{14695981039346656037ULL};
+  const auto mix{[&hash](const auto &values) {
+    const auto *bytes{reinterpret_cast<const unsigned char *>(values.data())};
+    for (std::size_t index = 0; index < values.size() * sizeof(values[0]);
+         ++index) {
+      hash = (hash ^ bytes[index]) * 1099511628211ULL;
+    }
+  }};
 
-  abcg::glUseProgram(0);
+  mix(m_translations);
+  mix(m_rotations);
+  mix(m_scales);
+  mix(m_meshes);
+  return hash;
 }
 
-void Items::terminateGL() {
-  for (auto item : m_items) {
-    abcg::glDeleteBuffers(1, &item.m_vbo);
-    abcg::glDeleteVertexArrays(1, &item.m_vao);
-  }
+Items::PoolStats Items::poolStats() const {
+  return {m_capacity, size(), m_highWater,
+          m_allocations + m_grid.allocations()};
 }
 
-void Items::update(const Car &car, float deltaTime) {
-  for (auto &item : m_items) {
-    item.m_translation -= car.m_velocity * deltaTime;
-    item.m_rotation = glm::wrapAngle(
-        item.m_rotation + item.m_angularVelocity * deltaTime);
-    item.m_translation += item.m_velocity * deltaTime;
-    
-    if (item.m_translation.x < -1.0f) item.m_translation.x += 2.0f;
-    if (item.m_translation.x > +1.0f) item.m_translation.x -= 2.0f;
-    if (item.m_translation.y < -1.0f) item.m_translation.y += 2.0f;
-    if (item.m_translation.y > +1.0f) item.m_translation.y -= 2.0f;
-  }
+void Items::copyDrawState(const Items &items) {
+  m_translations.assign(items.m_translations.begin(),
+                        items.m_translations.end());
+  m_rotations.assign(items.m_rotations.begin(), items.m_rotations.end());
+  m_scales.assign(items.m_scales.begin(), items.m_scales.end());
+  m_colors.assign(items.m_colors.begin(), items.m_colors.end());
+  m_meshes.assign(items.m_meshes.begin(), items.m_meshes.end());
+  m_previousTranslations.assign(items.m_previousTranslations.begin(),
+                                items.m_previousTranslations.end());
+  m_previousRotations.assign(items.m_previousRotations.begin(),
+                             items.m_previousRotations.end());
 }
 
-Items::Item Items::createItem(glm::vec2 translation,
-                                              float scale) {
-  Item item;
+void Items::reserve(std::size_t capacity) {
+  if (capacity <= m_capacity) return;
 
-  auto &re{m_randomEngine}; 
+  m_translations.reserve(capacity);
+  m_velocities.reserve(capacity);
+  m_rotations.reserve(capacity);
+  m_angularVelocities.reserve(capacity);
+  m_scales.reserve(capacity);
+  m_colors.reserve(capacity);
+  m_meshes.reserve(capacity);
+  m_alive.reserve(capacity);
+  m_previousTranslations.reserve(capacity);
+  m_previousRotations.reserve(capacity);
+  m_grid.reserve(capacity);
 
-  
-  std::uniform_int_distribution<int> randomSides(5, 9);
-  item.m_polygonSides = randomSides(re);
+  m_capacity = capacity;
+  ++m_allocations;
+}
 
-  
-  std::uniform_real_distribution<float> randomIntensity(0.5f, 1.0f);
-  item.m_color = glm::vec4(1) * randomIntensity(re);
+// The random attributes of all the new items are drawn together, one array
+// per attribute
+void Items::createItems(std::span<const glm::vec2> translations,
+                        float scale) {
+  const auto count{translations.size()};
+  if (count == 0) return;
 
-  item.m_color.a = 1.0f;
-  item.m_rotation = 0.0f;
-  item.m_scale = scale;
-  item.m_translation = translation;
+  // Sides and mesh variants, then angular velocities and directions
+  m_randomInts.resize(2 * count);
+  m_randomFloats.resize(3 * count);
+  const std::span ints{m_randomInts};
+  const std::span floats{m_randomFloats};
+  m_random.fillUniformInt(ints.first(count), minSides, maxSides);
+  m_random.fillUniformInt(ints.last(count), 0, meshVariants - 1);
+  m_random.fillUniform(floats, -1.0f, 1.0f);
 
-  
-  item.m_angularVelocity = m_randomDist(re);
+  if (size() + count > m_capacity) {
+    reserve(std::max<std::size_t>(
+        {m_capacity * 2, size() + count, std::size_t{64}}));
+  }
 
-  
-  glm::vec2 direction{m_randomDist(re), m_randomDist(re)};
-  item.m_velocity = glm::normalize(direction) / 7.0f;
+  for (auto index : iter::range(count)) {
+    const auto translation{translations[index]};
+    const auto polygonSides{ints[index]};
+    const auto mesh{(polygonSides - minSides) * meshVariants +
+                    ints[count + index]};
 
-  
-  std::vector<glm::vec2> positions(0);
-  positions.emplace_back(0, 0);
-  const auto step{M_PI * 2 / item.m_polygonSides};
-  std::uniform_real_distribution<float> randomRadius(0.8f, 1.0f);
-  for (const auto angle : iter::range(0.0, M_PI * 2, step)) {
-    const auto radius{randomRadius(re)};
-    positions.emplace_back(radius * std::cos(angle), radius * std::sin(angle));
+    const auto angularVelocity{floats[index]};
+    const glm::vec2 direction{floats[count + 2 * index],
+                              floats[count + 2 * index + 1]};
+
+    m_translations.push_back(translation);
+    m_velocities.push_back(glm::normalize(direction) * speed);
+    m_rotations.push_back(0.0f);
+    m_angularVelocities.push_back(angularVelocity);
+    m_scales.push_back(scale);
+    m_colors.push_back(itemColor);
+    m_meshes.push_back(mesh);
+    m_alive.push_back(1);
+    m_previousTranslations.push_back(translation);
+    m_previousRotations.push_back(0.0f);
+
+    m_grid.insert(size() - 1, translation);
   }
-  positions.push_back(positions.at(1));
+  m_highWater = std::max(m_highWater, size());
+}
 
-  
-  abcg::glGenBuffers(1, &item.m_vbo);
-  abcg::glBindBuffer(GL_ARRAY_BUFFER, item.m_vbo);
-  abcg::glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec2),
-                     positions.data(), GL_STATIC_DRAW);
-  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+// Swap-and-pop removal of the given items. Removing from the highest index
+// down guarantees that the item swapped into place is never a pending one.
+// Leaves dead in that order, for the World to mirror the removal
+void Items::removeDeadItems(std::vector<std::size_t> &dead) {
+  std::sort(dead.begin(), dead.end(), std::greater<>());
 
-  
-  GLint positionAttribute{abcg::glGetAttribLocation(m_program, "inPosition")};
+  for (const auto index : dead) {
+    const auto last{size() - 1};
+    m_translations[index] = m_translations[last];
+    m_velocities[index] = m_velocities[last];
+    m_rotations[index] = m_rotations[last];
+    m_angularVelocities[index] = m_angularVelocities[last];
+    m_scales[index] = m_scales[last];
+    m_colors[index] = m_colors[last];
+    m_meshes[index] = m_meshes[last];
+    m_alive[index] = m_alive[last];
+    m_previousTranslations[index] = m_previousTranslations[last];
+    m_previousRotations[index] = m_previousRotations[last];
 
-  
-  abcg::glGenVertexArrays(1, &item.m_vao);
+    m_translations.pop_back();
+    m_velocities.pop_back();
+    m_rotations.pop_back();
+    m_angularVelocities.pop_back();
+    m_scales.pop_back();
+    m_colors.pop_back();
+    m_meshes.pop_back();
+    m_alive.pop_back();
+    m_previousTranslations.pop_back();
+    m_previousRotations.pop_back();
 
-  
-  abcg::glBindVertexArray(item.m_vao);
+    m_grid.remove(index);
+  }
+}
 
-  abcg::glBindBuffer(GL_ARRAY_BUFFER, item.m_vbo);
-  abcg::glEnableVertexAttribArray(positionAttribute);
-  abcg::glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, GL_FALSE, 0,
-                              nullptr);
-  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
-  
-  abcg::glBindVertexArray(0);
+// Interpolates across the wrap seam instead of through the middle of the
+// screen when the item wrapped during the last tick
+glm::vec2 Items::renderTranslation(std::size_t index,
+                                   float interpolation) const {
+  const auto previous{m_previousTranslations[index]};
+  return previous +
+         SpatialGrid::wrappedDelta(previous, m_translations[index]) *
+             interpolation;
+}
 
-  return item;
-}
\ No newline at end of file
+float Items::renderRotation(std::size_t index, float interpolation) const {
+  const auto previous{m_previousRotations[index]};
+  const auto turn{glm::wrapAngle(m_rotations[index] - previous +
+                                 glm::pi<float>()) -
+                  glm::pi<float>()};
+  return previous + turn * interpolation;
+}
@@ -1,54 +1,101 @@
 #ifndef ITEMS_HPP_
 #define ITEMS_HPP_
 
-#include <list>
-#include <random>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 
-#include "abcg.hpp"
-#include "gamedata.hpp"
 #include "car.hpp"
+#include "philox.hpp"
+#include "spatialgrid.hpp"
+#include "threadpool.hpp"
 
+class ItemsFeedback;
+class ItemsRenderer;
 class OpenGLWindow;
+class Snapshot;
+class SoftwareRenderer;
+class World;
 
 class Items {
  public:
-  void initializeGL(GLuint program, int quantity);
-  void paintGL();
-  void terminateGL();
+  void reset(int quantity, unsigned int seed);
+  void update(const Car &car, float deltaTime, ThreadPool &pool);
+
+  [[nodiscard]] std::size_t size() const { return m_translations.size(); }
+  [[nodiscard]] std::uint64_t checksum() const;
+
+  // Item storage is a fixed-capacity pool. A dead item's slot goes back to
+  // the free tail of the arrays and spawning takes from it, so gameplay only
+  // touches the heap when the pool or a grid cell has to grow
+  struct PoolStats {
+    std::size_t capacity{};
+    std::size_t live{};
+    std::size_t highWater{};
+    int allocations{};
+  };
+
+  [[nodiscard]] PoolStats poolStats() const;
 
-  void update(const Car &car, float deltaTime);
+  // Only what drawing reads of items, into arrays that keep their capacity,
+  // so that copying every tick stops allocating
+  void copyDrawState(const Items &items);
+
+  static constexpr int minSides{5};
+  static constexpr int maxSides{9};
+  static constexpr int meshVariants{8};
+  static constexpr int numMeshes{(maxSides - minSides + 1) * meshVariants};
+  static constexpr float maxScale{0.10f};
+  // Every item drifts at this speed, in its own direction
+  static constexpr float speed{1.0f / 7.0f};
 
  private:
+  friend ItemsFeedback;
+  friend ItemsRenderer;
   friend OpenGLWindow;
+  friend Snapshot;
+  friend SoftwareRenderer;
+  friend World;
 
-  GLuint m_program{};
-  GLint m_colorLoc{};
-  GLint m_rotationLoc{};
-  GLint m_translationLoc{};
-  GLint m_scaleLoc{};
-
-  struct Item {
-    GLuint m_vao{};
-    GLuint m_vbo{};
-
-    float m_angularVelocity{};
-    glm::vec4 m_color{1};
-    bool m_hit{false};   
-    int m_polygonSides{};
-    float m_rotation{};
-    float m_scale{};
-    glm::vec2 m_translation{glm::vec2(0)};
-    glm::vec2 m_velocity{glm::vec2(0)};
-  };
+  // Item state as a structure of arrays: item i is the i-th entry of every
+  // array. Removing an item swaps the last one into its place
+  std::vector<glm::vec2> m_translations;
+  std::vector<glm::vec2> m_velocities;
+  std::vector<float> m_rotations;
+  std::vector<float> m_angularVelocities;
+  std::vector<float> m_scales;
+  std::vector<glm::vec4> m_colors;
+  std::vector<int> m_meshes;
+  std::vector<std::uint8_t> m_alive;
+
+  // State at the start of the last simulation tick, for render interpolation
+  std::vector<glm::vec2> m_previousTranslations;
+  std::vector<float> m_previousRotations;
+
+  // Broadphase over m_translations, updated as items move
+  SpatialGrid m_grid;
 
-  
-  std::list<Item> m_items;
+  std::size_t m_capacity{};
+  std::size_t m_highWater{};
+  int m_allocations{};
 
-  std::default_random_engine m_randomEngine;
-  std::uniform_real_distribution<float> m_randomDist{-1.0f, 1.0f};
+  Philox m_random;
+  // Scratch for the batched draws of createItems() and reset()
+  std::vector<float> m_randomFloats;
+  std::vector<int> m_randomInts;
+  std::vector<glm::vec2> m_spawnTranslations;
 
-  Items::Item createItem(glm::vec2 translation = glm::vec2(0),
-                                     float scale = 0.10f);
+  void reserve(std::size_t capacity);
+  void createItems(std::span<const glm::vec2> translations,
+                   float scale = maxScale);
+  void removeDeadItems(std::vector<std::size_t> &dead);
+  [[nodiscard]] glm::vec2 renderTranslation(std::size_t index,
+                                            float interpolation) const;
+  [[nodiscard]] float renderRotation(std::size_t index,
+                                     float interpolation) const;
 };
 
-#endif
\ No newline at end of file
+#endif
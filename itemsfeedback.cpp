@@ -0,0 +1,354 @@
+#include "itemsfeedback.hpp"
+
+#if !defined(__EMSCRIPTEN__)
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+// Read back as written by itemscandidates.geom
+static_assert(sizeof(ItemsMotion::Candidate) == 3 * sizeof(float));
+
+namespace {
+
+GLuint compileShader(GLenum type, const std::string &path) {
+  std::ifstream stream{path};
+  if (!stream) {
+    throw abcg::Exception{
+        abcg::Exception::Runtime(fmt::format("Cannot open {}", path))};
+  }
+  std::stringstream buffer;
+  buffer << stream.rdbuf();
+  const auto source{buffer.str()};
+  const auto *sourceData{source.c_str()};
+
+  const auto shader{abcg::glCreateShader(type)};
+  abcg::glShaderSource(shader, 1, &sourceData, nullptr);
+  abcg::glCompileShader(shader);
+
+  GLint status{};
+  abcg::glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (status == GL_FALSE) {
+    std::string log(1024, '\0');
+    abcg::glGetShaderInfoLog(shader, static_cast<GLsizei>(log.size()),
+                             nullptr, log.data());
+    abcg::glDeleteShader(shader);
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to compile {}:\n{}", path, log.c_str()))};
+  }
+  return shader;
+}
+
+// Links a program without a fragment shader whose outputs, in the order
+// given, are captured interleaved into a single buffer
+GLuint createFeedbackProgram(
+    const std::vector<std::pair<GLenum, std::string>> &shaders,
+    const std::vector<const char *> &varyings) {
+  const auto program{abcg::glCreateProgram()};
+  std::vector<GLuint> compiled;
+  for (const auto &[type, path] : shaders) {
+    compiled.push_back(compileShader(type, path));
+    abcg::glAttachShader(program, compiled.back());
+  }
+
+  abcg::glTransformFeedbackVaryings(program,
+                                    static_cast<GLsizei>(varyings.size()),
+                                    varyings.data(), GL_INTERLEAVED_ATTRIBS);
+  abcg::glLinkProgram(program);
+
+  for (const auto shader : compiled) {
+    abcg::glDetachShader(program, shader);
+    abcg::glDeleteShader(shader);
+  }
+
+  GLint status{};
+  abcg::glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status == GL_FALSE) {
+    std::string log(1024, '\0');
+    abcg::glGetProgramInfoLog(program, static_cast<GLsizei>(log.size()),
+                              nullptr, log.data());
+    abcg::glDeleteProgram(program);
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to link feedback program:\n{}", log.c_str()))};
+  }
+  return program;
+}
+
+}  // namespace
+
+void ItemsFeedback::initializeGL(const std::string &assetsPath) {
+  terminateGL();
+
+  m_motionProgram = createFeedbackProgram(
+      {{GL_VERTEX_SHADER, assetsPath + "itemsmotion.vert"}},
+      {"outTranslation", "outRotation"});
+  m_carOffsetLoc = abcg::glGetUniformLocation(m_motionProgram, "carOffset");
+  m_deltaTimeLoc = abcg::glGetUniformLocation(m_motionProgram, "deltaTime");
+
+  m_candidatesProgram = createFeedbackProgram(
+      {{GL_VERTEX_SHADER, assetsPath + "itemscandidates.vert"},
+       {GL_GEOMETRY_SHADER, assetsPath + "itemscandidates.geom"}},
+      {"outTranslation", "outIndex"});
+  m_centerLoc = abcg::glGetUniformLocation(m_candidatesProgram, "center");
+  m_radiusLoc = abcg::glGetUniformLocation(m_candidatesProgram, "radius");
+
+  abcg::glGenBuffers(2, m_stateVbos.data());
+  abcg::glGenBuffers(1, &m_constantsVbo);
+  abcg::glGenBuffers(1, &m_candidatesVbo);
+  abcg::glGenQueries(1, &m_candidatesQuery);
+
+  // Attribute locations fixed by itemsmotion.vert and itemscandidates.vert
+  abcg::glGenVertexArrays(1, &m_vao);
+  abcg::glBindVertexArray(m_vao);
+  for (auto location : {0, 1, 2, 3}) {
+    abcg::glEnableVertexAttribArray(location);
+  }
+  abcg::glBindVertexArray(0);
+
+  m_size = 0;
+  m_capacity = 0;
+  m_current = 0;
+}
+
+void ItemsFeedback::terminateGL() {
+  abcg::glDeleteProgram(m_motionProgram);
+  abcg::glDeleteProgram(m_candidatesProgram);
+  abcg::glDeleteBuffers(2, m_stateVbos.data());
+  abcg::glDeleteBuffers(1, &m_constantsVbo);
+  abcg::glDeleteBuffers(1, &m_candidatesVbo);
+  abcg::glDeleteVertexArrays(1, &m_vao);
+  abcg::glDeleteQueries(1, &m_candidatesQuery);
+  m_motionProgram = m_candidatesProgram = 0;
+  m_stateVbos = {};
+  m_constantsVbo = m_candidatesVbo = m_vao = m_candidatesQuery = 0;
+}
+
+void ItemsFeedback::upload(const Items &items) {
+  m_size = 0;
+  reserve(std::max(items.poolStats().capacity, items.size()));
+  m_size = items.size();
+  fill(items, 0);
+}
+
+void ItemsFeedback::download(Items &items) {
+  m_states.resize(m_size);
+  const auto bytes{static_cast<GLsizeiptr>(m_size * sizeof(State))};
+
+  for (const auto vbo : {currentState(), previousState()}) {
+    abcg::glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+    abcg::glGetBufferSubData(GL_COPY_READ_BUFFER, 0, bytes, m_states.data());
+
+    const auto current{vbo == currentState()};
+    auto &translations{current ? items.m_translations
+                               : items.m_previousTranslations};
+    auto &rotations{current ? items.m_rotations : items.m_previousRotations};
+    for (std::size_t index = 0; index < m_size; ++index) {
+      translations[index] = m_states[index].m_translation;
+      rotations[index] = m_states[index].m_rotation;
+    }
+  }
+  abcg::glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void ItemsFeedback::advance(glm::vec2 carOffset, float deltaTime) {
+  if (m_size == 0) return;
+
+  abcg::glUseProgram(m_motionProgram);
+  abcg::glUniform2f(m_carOffsetLoc, carOffset.x, carOffset.y);
+  abcg::glUniform1f(m_deltaTimeLoc, deltaTime);
+
+  abcg::glBindVertexArray(m_vao);
+  setStateAttributes(currentState());
+  abcg::glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, previousState());
+
+  abcg::glEnable(GL_RASTERIZER_DISCARD);
+  abcg::glBeginTransformFeedback(GL_POINTS);
+  abcg::glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_size));
+  abcg::glEndTransformFeedback();
+  abcg::glDisable(GL_RASTERIZER_DISCARD);
+
+  abcg::glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  abcg::glBindVertexArray(0);
+  abcg::glUseProgram(0);
+
+  m_current = 1 - m_current;
+}
+
+// Waits for the GPU, but only reads back the items that passed the test
+void ItemsFeedback::candidates(glm::vec2 center, float radius,
+                               std::vector<Candidate> &candidates) {
+  candidates.clear();
+  if (m_size == 0) return;
+
+  abcg::glUseProgram(m_candidatesProgram);
+  abcg::glUniform2f(m_centerLoc, center.x, center.y);
+  abcg::glUniform1f(m_radiusLoc, radius);
+
+  abcg::glBindVertexArray(m_vao);
+  setStateAttributes(currentState());
+  abcg::glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_candidatesVbo);
+
+  abcg::glEnable(GL_RASTERIZER_DISCARD);
+  abcg::glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN,
+                     m_candidatesQuery);
+  abcg::glBeginTransformFeedback(GL_POINTS);
+  abcg::glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_size));
+  abcg::glEndTransformFeedback();
+  abcg::glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+  abcg::glDisable(GL_RASTERIZER_DISCARD);
+
+  abcg::glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  abcg::glBindVertexArray(0);
+  abcg::glUseProgram(0);
+
+  GLuint written{};
+  abcg::glGetQueryObjectuiv(m_candidatesQuery, GL_QUERY_RESULT, &written);
+  if (written == 0) return;
+
+  candidates.resize(written);
+  abcg::glBindBuffer(GL_COPY_READ_BUFFER, m_candidatesVbo);
+  abcg::glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                           static_cast<GLsizeiptr>(written * sizeof(Candidate)),
+                           candidates.data());
+  abcg::glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void ItemsFeedback::append(const Items &items, std::size_t first) {
+  if (items.size() > m_capacity) {
+    reserve(std::max(items.size(), m_capacity * 2));
+  }
+  m_size = items.size();
+  fill(items, first);
+}
+
+// Same swap-and-pop as Items::removeDeadItems, done in every buffer
+void ItemsFeedback::remove(const std::vector<std::size_t> &dead) {
+  const auto copy{[](GLuint vbo, std::size_t size, std::size_t from,
+                     std::size_t to) {
+    abcg::glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+    abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    abcg::glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                              static_cast<GLintptr>(from * size),
+                              static_cast<GLintptr>(to * size),
+                              static_cast<GLsizeiptr>(size));
+  }};
+
+  for (const auto index : dead) {
+    const auto last{m_size - 1};
+    if (index != last) {
+      for (const auto vbo : m_stateVbos) {
+        copy(vbo, sizeof(State), last, index);
+      }
+      copy(m_constantsVbo, sizeof(Constants), last, index);
+    }
+    --m_size;
+  }
+
+  abcg::glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Grows every buffer to capacity items, keeping the first m_size
+void ItemsFeedback::reserve(std::size_t capacity) {
+  if (capacity <= m_capacity) return;
+
+  const auto grow{[this, capacity](GLuint &vbo, std::size_t size) {
+    GLuint grown{};
+    abcg::glGenBuffers(1, &grown);
+    abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    abcg::glBufferData(GL_COPY_WRITE_BUFFER,
+                       static_cast<GLsizeiptr>(capacity * size), nullptr,
+                       GL_DYNAMIC_COPY);
+    if (m_size > 0) {
+      abcg::glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+      abcg::glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                                0, static_cast<GLsizeiptr>(m_size * size));
+    }
+    abcg::glDeleteBuffers(1, &vbo);
+    vbo = grown;
+  }};
+
+  for (auto &vbo : m_stateVbos) {
+    grow(vbo, sizeof(State));
+  }
+  grow(m_constantsVbo, sizeof(Constants));
+
+  abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, m_candidatesVbo);
+  abcg::glBufferData(GL_COPY_WRITE_BUFFER,
+                     static_cast<GLsizeiptr>(capacity * sizeof(Candidate)),
+                     nullptr, GL_DYNAMIC_READ);
+  abcg::glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  // The motion pass reads velocities from the constants
+  abcg::glBindVertexArray(m_vao);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_constantsVbo);
+  const auto stride{static_cast<GLsizei>(sizeof(Constants))};
+  abcg::glVertexAttribPointer(
+      2, 2, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<void *>(offsetof(Constants, m_velocity)));
+  abcg::glVertexAttribPointer(
+      3, 1, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<void *>(offsetof(Constants, m_angularVelocity)));
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  abcg::glBindVertexArray(0);
+
+  m_capacity = capacity;
+}
+
+// Uploads items [first, size) to both state buffers and the constants
+void ItemsFeedback::fill(const Items &items, std::size_t first) {
+  const auto count{items.size() - first};
+  if (count == 0) return;
+
+  m_constants.resize(count);
+  for (std::size_t index = 0; index < count; ++index) {
+    const auto item{first + index};
+    m_constants[index] = {items.m_colors[item], items.m_velocities[item],
+                          items.m_angularVelocities[item],
+                          items.m_scales[item], items.m_meshes[item]};
+  }
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_constantsVbo);
+  abcg::glBufferSubData(GL_ARRAY_BUFFER,
+                        static_cast<GLintptr>(first * sizeof(Constants)),
+                        static_cast<GLsizeiptr>(count * sizeof(Constants)),
+                        m_constants.data());
+
+  m_states.resize(count);
+  for (const auto vbo : {currentState(), previousState()}) {
+    const auto current{vbo == currentState()};
+    const auto &translations{current ? items.m_translations
+                                     : items.m_previousTranslations};
+    const auto &rotations{current ? items.m_rotations
+                                  : items.m_previousRotations};
+    for (std::size_t index = 0; index < count; ++index) {
+      m_states[index] = {translations[first + index],
+                         rotations[first + index]};
+    }
+    abcg::glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    abcg::glBufferSubData(GL_ARRAY_BUFFER,
+                          static_cast<GLintptr>(first * sizeof(State)),
+                          static_cast<GLsizeiptr>(count * sizeof(State)),
+                          m_states.data());
+  }
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Expects m_vao to be bound
+void ItemsFeedback::setStateAttributes(GLuint vbo) {
+  const auto stride{static_cast<GLsizei>(sizeof(State))};
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  abcg::glVertexAttribPointer(
+      0, 2, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<void *>(offsetof(State, m_translation)));
+  abcg::glVertexAttribPointer(
+      1, 1, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<void *>(offsetof(State, m_rotation)));
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif
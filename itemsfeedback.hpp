@@ -0,0 +1,84 @@
+#ifndef ITEMSFEEDBACK_HPP_
+#define ITEMSFEEDBACK_HPP_
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "abcg.hpp"
+#include "items.hpp"
+#include "itemsmotion.hpp"
+
+class ItemsRenderer;
+
+// Item motion on the GPU. Translations and rotations live in two buffers
+// that a transform feedback pass advances in turns, so that the previous
+// state stays around for render interpolation. A second pass keeps only the
+// items near the car, and those are the only ones read back
+class ItemsFeedback : public ItemsMotion {
+ public:
+  void initializeGL(const std::string &assetsPath);
+  void terminateGL();
+
+  void upload(const Items &items) override;
+  void download(Items &items) override;
+  void advance(glm::vec2 carOffset, float deltaTime) override;
+  void candidates(glm::vec2 center, float radius,
+                  std::vector<Candidate> &candidates) override;
+  void append(const Items &items, std::size_t first) override;
+  void remove(const std::vector<std::size_t> &dead) override;
+
+ private:
+  friend ItemsRenderer;
+
+  // Advanced by the motion pass
+  struct State {
+    glm::vec2 m_translation{};
+    float m_rotation{};
+  };
+
+  // Only changes when items are spawned or removed
+  struct Constants {
+    glm::vec4 m_color{};
+    glm::vec2 m_velocity{};
+    float m_angularVelocity{};
+    float m_scale{};
+    int m_mesh{};
+  };
+
+  GLuint m_motionProgram{};
+  GLint m_carOffsetLoc{};
+  GLint m_deltaTimeLoc{};
+
+  GLuint m_candidatesProgram{};
+  GLint m_centerLoc{};
+  GLint m_radiusLoc{};
+
+  // m_stateVbos[m_current] holds the state after the last advance() and
+  // the other one the state before it
+  std::array<GLuint, 2> m_stateVbos{};
+  std::size_t m_current{};
+  GLuint m_constantsVbo{};
+  GLuint m_candidatesVbo{};
+  GLuint m_vao{};
+  GLuint m_candidatesQuery{};
+
+  std::size_t m_size{};
+  std::size_t m_capacity{};
+
+  std::vector<State> m_states;
+  std::vector<Constants> m_constants;
+
+  [[nodiscard]] GLuint currentState() const {
+    return m_stateVbos.at(m_current);
+  }
+  [[nodiscard]] GLuint previousState() const {
+    return m_stateVbos.at(1 - m_current);
+  }
+
+  void reserve(std::size_t capacity);
+  void fill(const Items &items, std::size_t first);
+  void setStateAttributes(GLuint vbo);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ITEMSMOTION_HPP_
+#define ITEMSMOTION_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+class Items;
+
+// Moves the items somewhere other than Items::update, such as the GPU. While
+// one is set, the World calls advance() instead of Items::update and only
+// tests the candidates it reports against the car. The World also reports
+// every item it spawns or removes, so both sides keep the same indices
+class ItemsMotion {
+ public:
+  struct Candidate {
+    glm::vec2 m_translation;
+    int m_index;
+  };
+
+  virtual ~ItemsMotion() = default;
+
+  // Copies the whole item state in, or back to the Items
+  virtual void upload(const Items &items) = 0;
+  virtual void download(Items &items) = 0;
+
+  virtual void advance(glm::vec2 carOffset, float deltaTime) = 0;
+
+  // Items whose wrapped distance to center is below radius, by index
+  virtual void candidates(glm::vec2 center, float radius,
+                          std::vector<Candidate> &candidates) = 0;
+
+  // Items appended from index first on, and items removed by swap-and-pop
+  // from the highest index down
+  virtual void append(const Items &items, std::size_t first) = 0;
+  virtual void remove(const std::vector<std::size_t> &dead) = 0;
+};
+
+#endif
@@ -0,0 +1,422 @@
+#include "itemsrenderer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <cstddef>
+#include <glm/gtc/constants.hpp>
+
+void ItemsRenderer::initializeGL(GLuint program, GLuint instancedProgram,
+                                 GLuint pointsProgram, GLuint feedbackProgram,
+                                 unsigned int seed) {
+  terminateGL();
+
+  m_program = program;
+
+  m_instancedProgram = instancedProgram;
+  m_meshes.create(seed);
+  createMeshPool();
+
+  m_pointsProgram = pointsProgram;
+  abcg::glGenVertexArrays(1, &m_pointsVao);
+  abcg::glBindVertexArray(m_pointsVao);
+  for (auto location : {0, 1, 2}) {
+    abcg::glEnableVertexAttribArray(location);
+  }
+  abcg::glBindVertexArray(0);
+
+#if !defined(__EMSCRIPTEN__)
+  m_feedbackProgram = feedbackProgram;
+  if (m_feedbackProgram == 0) return;
+
+  m_interpolationLoc =
+      abcg::glGetUniformLocation(m_feedbackProgram, "interpolation");
+
+  abcg::glGenTextures(1, &m_meshTexture);
+  abcg::glBindTexture(GL_TEXTURE_BUFFER, m_meshTexture);
+  abcg::glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, m_meshVbo);
+  abcg::glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  abcg::glUseProgram(m_feedbackProgram);
+  abcg::glUniform1i(
+      abcg::glGetUniformLocation(m_feedbackProgram, "meshPool"), 0);
+  abcg::glUniform1iv(
+      abcg::glGetUniformLocation(m_feedbackProgram, "meshFirst"),
+      Items::numMeshes, m_meshes.m_first.data());
+  abcg::glUniform1iv(
+      abcg::glGetUniformLocation(m_feedbackProgram, "meshCount"),
+      Items::numMeshes, m_meshes.m_count.data());
+  abcg::glUseProgram(0);
+
+  // Attribute locations fixed by itemsfeedback.vert, all per item
+  abcg::glGenVertexArrays(1, &m_feedbackVao);
+  abcg::glBindVertexArray(m_feedbackVao);
+  for (auto location : {0, 1, 2, 3, 4, 5, 6}) {
+    abcg::glEnableVertexAttribArray(location);
+    abcg::glVertexAttribDivisor(location, 9);
+  }
+  abcg::glBindVertexArray(0);
+#else
+  (void)feedbackProgram;
+#endif
+}
+
+void ItemsRenderer::resizeGL(int width, int height) {
+  // The [-1, 1] view spans the viewport, so a unit is half of it
+  m_pixelsPerUnit = static_cast<float>(std::min(width, height)) / 2.0f;
+}
+
+void ItemsRenderer::paintGL(const Items &items, glm::vec2 focus,
+                            StreamBuffer &stream, RenderQueue &queue,
+                            float interpolation) {
+  m_cullStats = {};
+  if (m_instanced) {
+    paintInstanced(items, focus, stream, queue, interpolation);
+  } else {
+    paintPerItem(items, queue, interpolation);
+  }
+}
+
+void ItemsRenderer::paintPerItem(const Items &items, RenderQueue &queue,
+                                 float interpolation) {
+  RenderQueue::Draw draw{};
+  draw.m_layer = RenderQueue::Layer::Items;
+  draw.m_program = m_program;
+  draw.m_vao = m_meshVao;
+  draw.m_mode = GL_TRIANGLE_FAN;
+
+  for (auto index : iter::range(items.size())) {
+    const auto translation{items.renderTranslation(index, interpolation)};
+    const auto mesh{items.m_meshes[index]};
+    draw.m_first = m_meshes.m_first.at(mesh);
+    draw.m_count = m_meshes.m_count.at(mesh);
+
+    RenderQueue::ObjectUniforms uniforms{};
+    uniforms.m_color = items.m_colors[index];
+    uniforms.m_rotation = items.renderRotation(index, interpolation);
+    uniforms.m_scale = items.m_scales[index];
+
+    const auto mask{tileMask(translation, items.m_scales[index])};
+    auto tile{0U};
+    for (auto i : {-2, 0, 2}) {
+      for (auto j : {-2, 0, 2}) {
+        if ((mask & (1U << tile++)) == 0) continue;
+        uniforms.m_translation = translation + glm::vec2(j, i);
+        queue.submit(draw, uniforms);
+      }
+    }
+
+    const auto drawn{static_cast<std::size_t>(std::popcount(mask))};
+    m_cullStats.drawn += drawn;
+    m_cullStats.culled += 9 - drawn;
+  }
+}
+
+void ItemsRenderer::paintInstanced(const Items &items, glm::vec2 focus,
+                                   StreamBuffer &stream, RenderQueue &queue,
+                                   float interpolation) {
+  if (items.size() == 0) return;
+
+  // Counting sort of the visible (item, tile) instances by mesh, so that
+  // each mesh is drawn from a contiguous range of the instance buffer
+  std::array<std::size_t, Items::numMeshes> groupSize{};
+  std::size_t points{};
+  m_tileMasks.resize(items.size());
+  for (auto index : iter::range(items.size())) {
+    const auto translation{items.renderTranslation(index, interpolation)};
+    const auto scale{items.m_scales[index]};
+    auto mask{tileMask(translation, scale)};
+    const auto copies{static_cast<std::size_t>(std::popcount(mask))};
+
+    if (m_pointLod && scale * m_pixelsPerUnit < pointRadius &&
+        SpatialGrid::wrappedDistance(translation, focus) > nearFocus) {
+      mask |= pointBit;
+      points += copies;
+    } else {
+      groupSize.at(items.m_meshes[index]) += copies;
+    }
+    m_tileMasks[index] = mask;
+  }
+
+  std::array<std::size_t, Items::numMeshes> groupStart{};
+  for (auto t : iter::range(1, Items::numMeshes)) {
+    groupStart.at(t) = groupStart.at(t - 1) + groupSize.at(t - 1);
+  }
+  const auto fans{groupStart.back() + groupSize.back()};
+  m_cullStats.drawn = fans + points;
+  m_cullStats.points = points;
+  m_cullStats.culled = items.size() * 9 - fans - points;
+  if (points > 0) paintPoints(items, points, stream, queue, interpolation);
+  if (fans == 0) return;
+
+  std::size_t offset{};
+  auto *instances{stream.allocate<Instance>(fans, offset)};
+  auto cursor{groupStart};
+  for (auto index : iter::range(items.size())) {
+    const auto mask{m_tileMasks[index]};
+    if ((mask & pointBit) != 0) continue;
+
+    auto &next{cursor.at(items.m_meshes[index])};
+    const auto translation{items.renderTranslation(index, interpolation)};
+    const auto rotation{items.renderRotation(index, interpolation)};
+    auto tile{0U};
+    for (auto i : {-2, 0, 2}) {
+      for (auto j : {-2, 0, 2}) {
+        if ((mask & (1U << tile++)) == 0) continue;
+        auto &instance{instances[next++]};
+        instance.m_color = items.m_colors[index];
+        instance.m_translation = translation;
+        instance.m_rotation = rotation;
+        instance.m_scale = items.m_scales[index];
+        instance.m_tileOffset = glm::vec2(j, i);
+      }
+    }
+  }
+
+  stream.commit();
+
+  // Without base instances (GL 4.2) each mesh needs its own VAO pointing at
+  // its range. They are set up now and stay untouched until the flush
+  RenderQueue::Draw draw{};
+  draw.m_layer = RenderQueue::Layer::Items;
+  draw.m_program = m_instancedProgram;
+  draw.m_mode = GL_TRIANGLE_FAN;
+
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+  for (auto t : iter::range(Items::numMeshes)) {
+    if (groupSize.at(t) == 0) continue;
+
+    abcg::glBindVertexArray(m_instancedVaos.at(t));
+    setInstanceAttributes(offset + groupStart.at(t) * sizeof(Instance));
+
+    draw.m_vao = m_instancedVaos.at(t);
+    draw.m_first = m_meshes.m_first.at(t);
+    draw.m_count = m_meshes.m_count.at(t);
+    draw.m_instances = static_cast<GLsizei>(groupSize.at(t));
+    queue.submit(draw);
+  }
+  abcg::glBindVertexArray(0);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// One point per visible copy of the items marked with pointBit
+void ItemsRenderer::paintPoints(const Items &items, std::size_t count,
+                                StreamBuffer &stream, RenderQueue &queue,
+                                float interpolation) {
+  std::size_t offset{};
+  auto *next{stream.allocate<Point>(count, offset)};
+  for (auto index : iter::range(items.size())) {
+    const auto mask{m_tileMasks[index]};
+    if ((mask & pointBit) == 0) continue;
+
+    // A square of about the area of the polygon. Below a pixel, the point
+    // fades instead, so that dense fields keep their overall shade
+    const auto translation{items.renderTranslation(index, interpolation)};
+    const auto side{std::sqrt(glm::pi<float>()) * items.m_scales[index] *
+                    m_pixelsPerUnit};
+    auto color{items.m_colors[index]};
+    color.a *= std::min(1.0f, side * side);
+    auto tile{0U};
+    for (auto i : {-2, 0, 2}) {
+      for (auto j : {-2, 0, 2}) {
+        if ((mask & (1U << tile++)) == 0) continue;
+        next->m_color = color;
+        next->m_translation = translation + glm::vec2(j, i);
+        next->m_size = std::max(1.0f, side);
+        ++next;
+      }
+    }
+  }
+  stream.commit();
+
+  // Attribute locations fixed by itempoints.vert
+  const auto stride{static_cast<GLsizei>(sizeof(Point))};
+  const auto pointer{[offset](std::size_t member) {
+    return reinterpret_cast<void *>(offset + member);
+  }};
+  abcg::glBindVertexArray(m_pointsVao);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+  abcg::glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Point, m_translation)));
+  abcg::glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Point, m_color)));
+  abcg::glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Point, m_size)));
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  abcg::glBindVertexArray(0);
+
+  RenderQueue::Draw draw{};
+  draw.m_layer = RenderQueue::Layer::Items;
+  draw.m_program = m_pointsProgram;
+  draw.m_vao = m_pointsVao;
+  draw.m_blend = true;
+  draw.m_mode = GL_POINTS;
+  draw.m_count = static_cast<GLsizei>(count);
+  queue.submit(draw);
+}
+
+void ItemsRenderer::paintFeedback(const ItemsFeedback &feedback,
+                                  RenderQueue &queue, float interpolation) {
+  // Culled in itemsfeedback.vert, and not counted
+  m_cullStats = {};
+#if !defined(__EMSCRIPTEN__)
+  if (feedback.m_size == 0) return;
+
+  abcg::glProgramUniform1f(m_feedbackProgram, m_interpolationLoc,
+                           interpolation);
+
+  // The state buffers swap roles on every tick, so point at them each frame
+  abcg::glBindVertexArray(m_feedbackVao);
+  const auto stateStride{static_cast<GLsizei>(sizeof(ItemsFeedback::State))};
+  const auto state{[&](GLuint vbo, GLuint translation, GLuint rotation) {
+    abcg::glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    abcg::glVertexAttribPointer(
+        translation, 2, GL_FLOAT, GL_FALSE, stateStride,
+        reinterpret_cast<void *>(
+            offsetof(ItemsFeedback::State, m_translation)));
+    abcg::glVertexAttribPointer(
+        rotation, 1, GL_FLOAT, GL_FALSE, stateStride,
+        reinterpret_cast<void *>(offsetof(ItemsFeedback::State, m_rotation)));
+  }};
+  state(feedback.previousState(), 0, 1);
+  state(feedback.currentState(), 2, 3);
+
+  const auto constantsStride{
+      static_cast<GLsizei>(sizeof(ItemsFeedback::Constants))};
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, feedback.m_constantsVbo);
+  abcg::glVertexAttribPointer(
+      4, 4, GL_FLOAT, GL_FALSE, constantsStride,
+      reinterpret_cast<void *>(offsetof(ItemsFeedback::Constants, m_color)));
+  abcg::glVertexAttribPointer(
+      5, 1, GL_FLOAT, GL_FALSE, constantsStride,
+      reinterpret_cast<void *>(offsetof(ItemsFeedback::Constants, m_scale)));
+  abcg::glVertexAttribIPointer(
+      6, 1, GL_INT, constantsStride,
+      reinterpret_cast<void *>(offsetof(ItemsFeedback::Constants, m_mesh)));
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  abcg::glBindVertexArray(0);
+
+  RenderQueue::Draw draw{};
+  draw.m_layer = RenderQueue::Layer::Items;
+  draw.m_program = m_feedbackProgram;
+  draw.m_vao = m_feedbackVao;
+  draw.m_texture = m_meshTexture;
+  draw.m_mode = GL_TRIANGLE_FAN;
+  draw.m_count = m_meshes.m_maxCount;
+  draw.m_instances = static_cast<GLsizei>(feedback.m_size * 9);
+  queue.submit(draw);
+#else
+  (void)feedback;
+  (void)queue;
+  (void)interpolation;
+#endif
+}
+
+void ItemsRenderer::terminateGL() {
+#if !defined(__EMSCRIPTEN__)
+  abcg::glDeleteTextures(1, &m_meshTexture);
+  abcg::glDeleteVertexArrays(1, &m_feedbackVao);
+  m_meshTexture = m_feedbackVao = 0;
+#endif
+  abcg::glDeleteBuffers(1, &m_meshVbo);
+  abcg::glDeleteVertexArrays(1, &m_meshVao);
+  abcg::glDeleteVertexArrays(1, &m_pointsVao);
+  abcg::glDeleteVertexArrays(Items::numMeshes, m_instancedVaos.data());
+  m_meshVbo = m_meshVao = m_pointsVao = 0;
+  m_instancedVaos = {};
+}
+
+// Mesh radii are at most 1, so an item reaches scale away from its center
+std::uint16_t ItemsRenderer::tileMask(glm::vec2 translation,
+                                      float scale) const {
+  if (!m_cullTiles) return 0x1FF;
+
+  // Bit k: the copy at offset 2 * k - 2 along the axis overlaps [-1, 1]
+  const auto axis{[scale](float coordinate) {
+    auto bits{0U};
+    for (auto k : {0, 1, 2}) {
+      const auto offset{static_cast<float>(2 * k - 2)};
+      if (std::abs(coordinate + offset) < 1.0f + scale) bits |= 1U << k;
+    }
+    return bits;
+  }};
+
+  const auto columns{axis(translation.x)};
+  const auto rows{axis(translation.y)};
+  auto mask{0U};
+  for (auto row : {0, 1, 2}) {
+    if ((rows & (1U << row)) != 0) mask |= columns << (3 * row);
+  }
+  return static_cast<std::uint16_t>(mask);
+}
+
+// Fills a single VBO with every item mesh. Items only keep the index of
+// their mesh
+void ItemsRenderer::createMeshPool() {
+  const auto &positions{m_meshes.m_positions};
+
+  abcg::glGenBuffers(1, &m_meshVbo);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_meshVbo);
+  abcg::glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec2),
+                     positions.data(), GL_STATIC_DRAW);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  GLint positionAttribute{abcg::glGetAttribLocation(m_program, "inPosition")};
+
+  abcg::glGenVertexArrays(1, &m_meshVao);
+
+  abcg::glBindVertexArray(m_meshVao);
+
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, m_meshVbo);
+  abcg::glEnableVertexAttribArray(positionAttribute);
+  abcg::glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, GL_FALSE, 0,
+                              nullptr);
+  abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  abcg::glBindVertexArray(0);
+
+  GLint instancedPositionAttribute{
+      abcg::glGetAttribLocation(m_instancedProgram, "inPosition")};
+
+  abcg::glGenVertexArrays(Items::numMeshes, m_instancedVaos.data());
+
+  for (const auto vao : m_instancedVaos) {
+    abcg::glBindVertexArray(vao);
+
+    abcg::glBindBuffer(GL_ARRAY_BUFFER, m_meshVbo);
+    abcg::glEnableVertexAttribArray(instancedPositionAttribute);
+    abcg::glVertexAttribPointer(instancedPositionAttribute, 2, GL_FLOAT,
+                                GL_FALSE, 0, nullptr);
+
+    // Per-instance attributes, at the locations fixed by items.vert. They
+    // are pointed at the stream buffer on every frame
+    for (auto location : {1, 2, 3, 4, 5}) {
+      abcg::glEnableVertexAttribArray(location);
+      abcg::glVertexAttribDivisor(location, 1);
+    }
+    abcg::glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  abcg::glBindVertexArray(0);
+}
+
+// Points the per-instance attributes at the instances starting at byte base.
+// Expects the instanced VAO and the buffer holding them to be bound
+void ItemsRenderer::setInstanceAttributes(std::size_t base) {
+  const auto pointer{[base](std::size_t offset) {
+    return reinterpret_cast<void *>(base + offset);
+  }};
+  const auto stride{static_cast<GLsizei>(sizeof(Instance))};
+
+  abcg::glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_color)));
+  abcg::glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_translation)));
+  abcg::glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_rotation)));
+  abcg::glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_scale)));
+  abcg::glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, stride,
+                              pointer(offsetof(Instance, m_tileOffset)));
+}
@@ -0,0 +1,112 @@
+#ifndef ITEMSRENDERER_HPP_
+#define ITEMSRENDERER_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "abcg.hpp"
+#include "itemmeshes.hpp"
+#include "items.hpp"
+#include "itemsfeedback.hpp"
+#include "renderqueue.hpp"
+#include "streambuffer.hpp"
+
+class OpenGLWindow;
+
+class ItemsRenderer {
+ public:
+  // seed picks the shapes of the mesh pool
+  void initializeGL(GLuint program, GLuint instancedProgram,
+                    GLuint pointsProgram, GLuint feedbackProgram,
+                    unsigned int seed);
+  void resizeGL(int width, int height);
+  // Submit the items' draws to queue. Items near focus, the car, always
+  // keep their shape
+  void paintGL(const Items &items, glm::vec2 focus, StreamBuffer &stream,
+               RenderQueue &queue, float interpolation = 1.0f);
+  // Draws the items straight from the ItemsFeedback buffers
+  void paintFeedback(const ItemsFeedback &feedback, RenderQueue &queue,
+                     float interpolation = 1.0f);
+  void terminateGL();
+
+  // (item, tile) copies drawn, drawn of those as points, and culled by the
+  // last paintGL
+  struct CullStats {
+    std::size_t drawn{};
+    std::size_t points{};
+    std::size_t culled{};
+  };
+  [[nodiscard]] const CullStats &cullStats() const { return m_cullStats; }
+
+ private:
+  friend OpenGLWindow;
+
+  GLuint m_program{};
+
+  // Shared mesh pool, all in m_meshVbo
+  ItemMeshes m_meshes;
+  GLuint m_meshVao{};
+  GLuint m_meshVbo{};
+
+  // Instanced path: one glDrawArraysInstanced per mesh, where each instance
+  // is an (item, tile) pair written straight into the stream buffer
+  struct Instance {
+    glm::vec4 m_color{1};
+    glm::vec2 m_translation{glm::vec2(0)};
+    float m_rotation{};
+    float m_scale{};
+    glm::vec2 m_tileOffset{glm::vec2(0)};
+  };
+
+  bool m_instanced{true};
+
+  // Each item is drawn at nine offsets of the wrapped world, but only the
+  // copies whose bounds reach the [-1, 1] view are kept. Bit 3 * row +
+  // column of a mask is the copy at (2 * column - 2, 2 * row - 2)
+  bool m_cullTiles{true};
+  CullStats m_cullStats;
+  std::vector<std::uint16_t> m_tileMasks;
+
+  // Level of detail of the instanced path: items smaller on screen than
+  // pointRadius pixels, and farther than nearFocus from the car, are drawn
+  // as single points instead of fans. Bit pointBit of their mask is set
+  static constexpr float pointRadius{2.0f};
+  static constexpr float nearFocus{0.25f};
+  static constexpr std::uint16_t pointBit{1U << 9};
+  struct Point {
+    glm::vec4 m_color{1};
+    glm::vec2 m_translation{glm::vec2(0)};
+    float m_size{};
+  };
+
+  bool m_pointLod{true};
+  GLuint m_pointsProgram{};
+  GLuint m_pointsVao{};
+  float m_pixelsPerUnit{300.0f};
+
+  GLuint m_instancedProgram{};
+  std::array<GLuint, Items::numMeshes> m_instancedVaos{};
+
+  // GPU motion path: one instanced fan per (item, tile) pair, with every
+  // mesh drawn as the largest one and vertices read from m_meshTexture
+  GLuint m_feedbackProgram{};
+  GLint m_interpolationLoc{};
+  GLuint m_feedbackVao{};
+  GLuint m_meshTexture{};
+
+  void createMeshPool();
+  [[nodiscard]] std::uint16_t tileMask(glm::vec2 translation,
+                                       float scale) const;
+  void paintInstanced(const Items &items, glm::vec2 focus,
+                      StreamBuffer &stream, RenderQueue &queue,
+                      float interpolation);
+  void paintPoints(const Items &items, std::size_t count,
+                   StreamBuffer &stream, RenderQueue &queue,
+                   float interpolation);
+  void paintPerItem(const Items &items, RenderQueue &queue,
+                    float interpolation);
+  void setInstanceAttributes(std::size_t base);
+};
+
+#endif
@@ -1,13 +1,22 @@
 #include <fmt/core.h>
 
 #include "abcg.hpp"
+#include "headless.hpp"
+#include "inputlog.hpp"
 #include "openglwindow.hpp"
 
 int main(int argc, char **argv) {
   try {    
+    if (const auto options{parseHeadlessOptions(argc, argv)}) {
+      return runHeadless(*options);
+    }
+
+    const auto windowOptions{parseWindowOptions(argc, argv)};
+
     abcg::Application app(argc, argv);
     
     auto window{std::make_unique<OpenGLWindow>()};
+    window->setOptions(windowOptions);
     window->setOpenGLSettings({.profile = abcg::OpenGLProfile::Core,
                                .majorVersion = 4,
                                .minorVersion = 1});
@@ -18,6 +27,9 @@ int main(int argc, char **argv) {
   } catch (const abcg::Exception &exception) {
     fmt::print(stderr, "{}", exception.what());
     return -1;
+  } catch (const std::exception &exception) {
+    fmt::print(stderr, "{}\n", exception.what());
+    return -1;
   }
   return 0;
 }
\ No newline at end of file
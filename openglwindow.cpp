@@ -1,137 +1,615 @@
 #include "openglwindow.hpp"
 
+#include <fmt/core.h>
 #include <imgui.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cppitertools/itertools.hpp>
+#include <exception>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <gsl/gsl>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
 
 #include "abcg.hpp"
+#include "imgui_impl_opengl3.h"
 
-int m_objects = 0;
+#if defined(__EMSCRIPTEN__)
+#include <emscripten.h>
+#endif
 
+namespace {
+
+const char *const fontFile{"Inconsolata-UltraCondensedBlack.ttf"};
+
+// std::stoi only names itself when value is not a number
+int parseInt(std::string_view option, std::string_view value) {
+  try {
+    std::size_t end{};
+    const auto result{std::stoi(std::string{value}, &end)};
+    if (end == value.size()) return result;
+  } catch (const std::logic_error &) {
+  }
+  throw std::invalid_argument{
+      fmt::format("{} needs an integer, not {}", option, value)};
+}
+
+}  // namespace
+
+WindowOptions parseWindowOptions(int argc, char **argv) {
+  WindowOptions options;
+  options.inputLog = parseInputLogOptions(argc, argv);
+  for (int index = 1; index < argc; ++index) {
+    const std::string_view arg{argv[index]};
+    if (arg == "--no-idle") {
+      options.idle = false;
+      continue;
+    }
+    if (arg == "--no-sim-thread") {
+      options.simulationThread = false;
+      continue;
+    }
+    if (arg != "--items" && arg != "--fps" && arg != "--vsync" &&
+        arg != "--snapshot") {
+      continue;
+    }
+
+    if (index + 1 >= argc) {
+      throw std::invalid_argument{fmt::format("{} needs a value", arg)};
+    }
+    const std::string_view value{argv[++index]};
+    if (arg == "--snapshot") {
+      options.snapshot = value;
+    } else if (arg == "--items") {
+      options.items = parseInt(arg, value);
+      if (options.items < 0) {
+        throw std::invalid_argument{"--items must not be negative"};
+      }
+    } else if (arg == "--fps") {
+      options.maxFps = parseInt(arg, value);
+      if (options.maxFps < 0) {
+        throw std::invalid_argument{"--fps must not be negative"};
+      }
+    } else if (value == "off") {
+      options.vSync = FramePacer::VSync::Off;
+    } else if (value == "on") {
+      options.vSync = FramePacer::VSync::On;
+    } else if (value == "adaptive") {
+      options.vSync = FramePacer::VSync::Adaptive;
+    } else {
+      throw std::invalid_argument{"--vsync must be off, on or adaptive"};
+    }
+  }
+  if (!options.snapshot.empty() && (!options.inputLog.record.empty() ||
+                                    !options.inputLog.replay.empty())) {
+    throw std::invalid_argument{
+        "--snapshot cannot be combined with --record or --replay"};
+  }
+  return options;
+}
+
+// Keys and buttons become timestamped events for the ticks to consume,
+// wherever they run. SDL stamps events in milliseconds since its start,
+// when they are queued. A full queue drops the event, but the keys held
+// are kept aside for update() to catch up, so a lost release never leaves
+// a key stuck
 void OpenGLWindow::handleEvent(SDL_Event &event) {  
-  if (event.type == SDL_KEYDOWN || event.key.keysym.sym == SDLK_s) {
-    if (event.key.keysym.sym == SDLK_SPACE)
-      m_gameData.m_input.set(static_cast<size_t>(Input::Stop));
-    if (event.key.keysym.sym == SDLK_UP || event.key.keysym.sym == SDLK_w)
-      m_gameData.m_input.set(static_cast<size_t>(Input::Up));    
-    if (event.key.keysym.sym == SDLK_LEFT || event.key.keysym.sym == SDLK_a)
-      m_gameData.m_input.set(static_cast<size_t>(Input::Left));
-    if (event.key.keysym.sym == SDLK_RIGHT || event.key.keysym.sym == SDLK_d)
-      m_gameData.m_input.set(static_cast<size_t>(Input::Right));
-  }
-  if (event.type == SDL_KEYUP) {
-    if (event.key.keysym.sym == SDLK_SPACE || event.key.keysym.sym == SDLK_s)
-      m_gameData.m_input.reset(static_cast<size_t>(Input::Stop));
-    if (event.key.keysym.sym == SDLK_UP || event.key.keysym.sym == SDLK_w)
-      m_gameData.m_input.reset(static_cast<size_t>(Input::Up));    
-    if (event.key.keysym.sym == SDLK_LEFT || event.key.keysym.sym == SDLK_a)
-      m_gameData.m_input.reset(static_cast<size_t>(Input::Left));
-    if (event.key.keysym.sym == SDLK_RIGHT || event.key.keysym.sym == SDLK_d)
-      m_gameData.m_input.reset(static_cast<size_t>(Input::Right));
+  m_awakeFrames = 3;
+  if (event.type == SDL_WINDOWEVENT) {
+    if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) m_focused = false;
+    if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) m_focused = true;
   }
-  
-  if (event.type == SDL_MOUSEBUTTONDOWN) {
-    if (event.button.button == SDL_BUTTON_LEFT)
-      m_gameData.m_input.set(static_cast<size_t>(Input::Stop));
-    if (event.button.button == SDL_BUTTON_RIGHT)
-      m_gameData.m_input.set(static_cast<size_t>(Input::Up));
+  if (m_replay || m_replayFinished) return;
+
+  const auto input{[&event]() -> std::optional<Input> {
+    if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+      switch (event.key.keysym.sym) {
+        case SDLK_SPACE:
+        case SDLK_DOWN:
+        case SDLK_s:
+          return Input::Stop;
+        case SDLK_UP:
+        case SDLK_w:
+          return Input::Up;
+        case SDLK_LEFT:
+        case SDLK_a:
+          return Input::Left;
+        case SDLK_RIGHT:
+        case SDLK_d:
+          return Input::Right;
+        default:
+          return std::nullopt;
+      }
+    }
+    if (event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_MOUSEBUTTONUP) {
+      if (event.button.button == SDL_BUTTON_LEFT) return Input::Stop;
+      if (event.button.button == SDL_BUTTON_RIGHT) return Input::Up;
+    }
+    return std::nullopt;
+  }()};
+  if (!input) return;
+
+  const auto age{std::chrono::milliseconds(SDL_GetTicks() -
+                                           event.common.timestamp)};
+  const auto pressed{event.type == SDL_KEYDOWN ||
+                     event.type == SDL_MOUSEBUTTONDOWN};
+  const auto bit{
+      static_cast<std::uint8_t>(1U << static_cast<unsigned>(*input))};
+  if (pressed) {
+    m_heldInputs.fetch_or(bit, std::memory_order_relaxed);
+  } else {
+    m_heldInputs.fetch_and(static_cast<std::uint8_t>(~bit),
+                           std::memory_order_relaxed);
   }
-  if (event.type == SDL_MOUSEBUTTONUP) {
-    if (event.button.button == SDL_BUTTON_LEFT)
-      m_gameData.m_input.reset(static_cast<size_t>(Input::Stop));
-    if (event.button.button == SDL_BUTTON_RIGHT)
-      m_gameData.m_input.reset(static_cast<size_t>(Input::Up));
+  if (!m_inputEvents.push({InputQueue::Clock::now() - age, *input, pressed})) {
+    m_droppedInputs.fetch_add(1, std::memory_order_release);
   }
 }
+
 void OpenGLWindow::initializeGL() {  
   glEnable(GL_DEPTH_TEST);
 
-  ImGuiIO &io{ImGui::GetIO()};
-  const auto filename{getAssetsPath() + "Inconsolata-UltraCondensedBlack.ttf"};
-  m_font = io.Fonts->AddFontFromFileTTF(filename.c_str(), 45.0f);  
-  if (m_font == nullptr) {
-    throw abcg::Exception{abcg::Exception::Runtime("Cannot load font file")};
-  }  
+#if defined(CAR_STREAM_FONT)
+  const auto fontPath{getAssetsPath() + fontFile};
+  emscripten_async_wget2(
+      fontPath.c_str(), fontPath.c_str(), "GET", "", this,
+      [](unsigned int, void *window, const char *) {
+        static_cast<OpenGLWindow *>(window)->m_fontAvailable = true;
+      },
+      [](unsigned int, void *, int status) {
+        fmt::print(stderr, "Cannot fetch the font file ({})\n", status);
+      },
+      nullptr);
+#else
+  m_fontAvailable = true;
+#endif
                               
   
   m_objectsProgram = createProgramFromFile(getAssetsPath() + "objects.vert",
                                            getAssetsPath() + "objects.frag");  
-  
-  glGenVertexArrays(1, &m_vao);
-
-  glBindVertexArray(m_vao);
-  
+  m_carProgram = createProgramFromFile(getAssetsPath() + "car.vert",
+                                       getAssetsPath() + "objects.frag");
+  m_itemsProgram = createProgramFromFile(getAssetsPath() + "items.vert",
+                                         getAssetsPath() + "objects.frag");
+  m_itemsPointsProgram =
+      createProgramFromFile(getAssetsPath() + "itempoints.vert",
+                            getAssetsPath() + "objects.frag");
+#if !defined(__EMSCRIPTEN__)
+  m_itemsFeedbackProgram =
+      createProgramFromFile(getAssetsPath() + "itemsfeedback.vert",
+                            getAssetsPath() + "objects.frag");
+  m_itemsFeedback.initializeGL(getAssetsPath());
+#endif
   
 #if !defined(__EMSCRIPTEN__)
   abcg::glEnable(GL_PROGRAM_POINT_SIZE);
   #endif
   
-  m_randomEngine.seed(
-      std::chrono::steady_clock::now().time_since_epoch().count());
+  // A replay brings its own seed, item count and tick rate
+  auto seed{static_cast<unsigned int>(
+      std::chrono::steady_clock::now().time_since_epoch().count())};
+  auto quantity{m_options.items};
+  if (!m_options.inputLog.replay.empty()) {
+    m_replay = InputLog::load(m_options.inputLog.replay);
+    m_replayTick = 0;
+    seed = m_replay->m_seed;
+    quantity = m_replay->m_items;
+    m_tickRate = m_replay->m_tickRate;
+    m_profiler.setRecording(true);
+  } else if (!m_options.inputLog.record.empty()) {
+    m_recording = InputLog{seed, quantity, m_tickRate, {}, 0};
+  }
 
-  restart();
-}
+  // A snapshot brings the seed of its mesh pool
+  m_world.setMeshSeed(seed);
+  m_world.restart(quantity, seed);
+  if (!m_options.snapshot.empty()) {
+    Snapshot::load(m_world, m_options.snapshot);
+  }
 
+  m_stream.initializeGL(64 * 1024);
+  m_carRenderer.initializeGL(m_carProgram);
+  createItemMeshes();
+  m_gpuTimer.initializeGL();
+  m_world.setProfiler(&m_profiler);
 
-void OpenGLWindow::restart() {
-  m_gameData.m_state = State::Playing;
-  m_car.initializeGL(m_objectsProgram);
-  m_items.initializeGL(m_objectsProgram, 100);
-  m_timerGame.restart();
-  
+  m_pacer.setVSync(m_options.vSync);
+  m_pacer.setMaxFps(m_options.maxFps);
+
+  publishFrame(InputQueue::Clock::now());
+  acquireFrame();
+  setThreadedSimulation(m_options.simulationThread);
 }
 
-void OpenGLWindow::update() {
-  float deltaTime{static_cast<float>(getDeltaTime())};
-  
-  if (m_gameData.m_state != State::Playing &&
-      m_restartWaitTimer.elapsed() > 5) {
-        m_objects = 0;
-    restart();
+// While the thread runs it owns m_world. Item motion on the GPU needs the
+// GL context, so it takes the simulation back to paintGL, and so does the
+// web build, whose workers are all in the thread pool
+void OpenGLWindow::setThreadedSimulation(bool threaded) {
+#if defined(__EMSCRIPTEN__)
+  threaded = false;
+#endif
+  if (threaded == m_threadedSimulation) return;
+
+  if (!threaded) {
+    m_simulation.stop();
+    m_threadedSimulation = false;
+    m_world.setProfiler(&m_profiler);
     return;
-  }  
+  }
 
-  m_car.update(m_gameData, deltaTime);
-  m_items.update(m_car, deltaTime);
+#if !defined(__EMSCRIPTEN__)
+  m_gpuMotion = false;
+  m_world.setItemsMotion(nullptr);
+#endif
+  m_world.setProfiler(nullptr);
+  m_threadedSimulation = true;
+  // The items are in frames from now on
+  publishFrame(m_frames.front().m_tickEnd);
+  acquireFrame();
+  m_overlap = {InputQueue::Clock::now()};
+  m_simulation.start([this](float deltaTime) { return update(deltaTime); });
+}
 
-  if (m_gameData.m_state == State::Playing) {
-  checkCollisions();
-  checkWinCondition();
+// Resuming a game is only offered outside recordings and replays, whose
+// runs start from a seed
+void OpenGLWindow::saveSnapshot() {
+  const auto path{m_options.snapshot.empty() ? std::string{"car.snapshot"}
+                                             : m_options.snapshot};
+  try {
+    const auto lock{m_simulation.lock()};
+    Snapshot::save(m_world, path);
+    m_snapshotStatus = fmt::format("Saved {}", path);
+  } catch (const std::exception &exception) {
+    m_snapshotStatus = exception.what();
   }
 }
- 
+
+void OpenGLWindow::loadSnapshot() {
+  const auto path{m_options.snapshot.empty() ? std::string{"car.snapshot"}
+                                             : m_options.snapshot};
+  try {
+    const auto lock{m_simulation.lock()};
+    Snapshot::load(m_world, path);
+    createItemMeshes();
+    m_tickAccumulator = 0.0f;
+    m_snapshotStatus = fmt::format("Loaded {}", path);
+  } catch (const std::exception &exception) {
+    m_snapshotStatus = exception.what();
+  }
+}
+
+// The mesh pool of the World's seed, which a loaded snapshot can change
+void OpenGLWindow::createItemMeshes() {
+  m_itemsRenderer.initializeGL(m_objectsProgram, m_itemsProgram,
+                               m_itemsPointsProgram, m_itemsFeedbackProgram,
+                               m_world.meshSeed());
+}
+
+bool OpenGLWindow::idle() const {
+  return m_idleEnabled && !m_replay && !m_replayFinished &&
+         (!m_focused ||
+          m_frames.front().m_world.m_gameData.m_state == State::Win);
+}
+
+// Runs the ticks due after deltaTime more seconds and publishes the state
+// they end in. Returns the seconds until the next tick is due
+float OpenGLWindow::update(float deltaTime) {
+  while (const auto *event{m_inputEvents.front()}) {
+    m_inputQueue.push(*event);
+    m_inputEvents.pop();
+  }
+  if (const auto dropped{m_droppedInputs.load(std::memory_order_acquire)};
+      dropped != m_reconciledDrops) {
+    m_reconciledDrops = dropped;
+    m_inputQueue.reconcile(m_heldInputs.load(std::memory_order_relaxed),
+                           InputQueue::Clock::now());
+  }
+
+  const auto tick{1.0f / m_tickRate};
+  if (m_replayFinished || m_replayEnded) {
+    // Nothing moves any more, so the frame shows the current state, and
+    // still shows a restart from the UI
+    publishFrame(InputQueue::Clock::time_point{});
+    return tick;
+  }
+  m_tickAccumulator += deltaTime;
+
+  // The accumulator is the time not simulated yet: a tick that leaves it at
+  // a seconds covers the time up to a seconds before now
+  const auto now{InputQueue::Clock::now()};
+  const auto tickEnd{[now](float accumulator) {
+    return now - std::chrono::duration_cast<InputQueue::Clock::duration>(
+                     std::chrono::duration<float>(accumulator));
+  }};
+
+  auto ticks{0};
+  // Ticks of the end screen only count down to the restart, so they are not
+  // capped: a frame after a long idle wait runs all of them
+  while (m_tickAccumulator >= tick &&
+         (ticks < m_maxTicksPerFrame ||
+          m_world.gameData().m_state == State::Win)) {
+    if (m_replay) {
+      if (m_replayTick == m_replay->m_inputs.size()) {
+        // paintGL finishes it, on its own thread
+        m_replayEnded = true;
+        break;
+      }
+      m_world.setInput(m_replay->m_inputs[m_replayTick++]);
+    } else {
+      // The last tick of the frame also takes the events after its end, so
+      // that none waits for the next frame
+      const auto last{m_tickAccumulator - tick < tick ||
+                      ticks + 1 == m_maxTicksPerFrame};
+      m_world.setInput(m_inputQueue.tick(
+          last ? now : tickEnd(m_tickAccumulator - tick)));
+    }
+    if (m_recording) {
+      m_recording->m_inputs.push_back(
+          static_cast<std::uint8_t>(m_world.m_gameData.m_input.to_ulong()));
+    }
+
+    m_world.step(tick);
+    if (!m_replay) m_world.setInput(m_inputQueue.held());
+    m_tickAccumulator -= tick;
+    ++ticks;
+    ++m_ticks;
+  }
+
+  // Drop the time that could not be caught up instead of spiraling
+  if (m_tickAccumulator >= tick) {
+    m_tickAccumulator = std::fmod(m_tickAccumulator, tick);
+  }
+
+  for (const auto time : m_inputQueue.consumed()) {
+    (void)m_presses.push({m_ticks, time});
+  }
+  m_inputQueue.clearConsumed();
+
+  publishFrame(tickEnd(m_tickAccumulator));
+  return tick - m_tickAccumulator;
+}
+
+void OpenGLWindow::publishFrame(InputQueue::Clock::time_point tickEnd) {
+  auto &frame{m_frames.back()};
+  m_world.copyFrame(frame.m_world, m_threadedSimulation);
+  frame.m_ticks = m_ticks;
+  frame.m_tickEnd = tickEnd;
+  frame.m_tickRate = m_tickRate;
+  frame.m_replayTick = m_replayTick;
+  m_frames.publish();
+}
+
+// Moves to the newest frame, if there is one. What the simulation thread
+// spent on items and collisions since the last one goes into this frame's
+// profile, at the time it is drawn
+void OpenGLWindow::acquireFrame() {
+  if (!m_frames.acquire()) {
+    m_frameAllocations = 0;
+    return;
+  }
+
+  const auto &world{m_frames.front().m_world};
+  if (m_threadedSimulation) {
+    const auto now{Profiler::Clock::now()};
+    m_profiler.add(Profiler::Stage::ItemsUpdate, now,
+                   std::max(0.0, world.m_stageTimes.items -
+                                     m_drawnStageTimes.items));
+    m_profiler.add(Profiler::Stage::Collisions, now,
+                   std::max(0.0, world.m_stageTimes.collisions -
+                                     m_drawnStageTimes.collisions));
+  }
+  m_drawnStageTimes = world.m_stageTimes;
+  m_frameAllocations =
+      std::max(0, world.m_pool.allocations - m_drawnAllocations);
+  m_drawnAllocations = world.m_pool.allocations;
+}
+
 void OpenGLWindow::paintGL() {  
-  glClearColor(gsl::at(m_clearColor, 0), gsl::at(m_clearColor, 1),
-               gsl::at(m_clearColor, 2), gsl::at(m_clearColor, 3));  
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  
-  glViewport(0, 0, m_viewportWidth, m_viewportHeight);  
-  
-  glBindVertexArray(m_vao);
-  
-  glBindVertexArray(0);
-  
-  glUseProgram(0);
+  if (m_font == nullptr && m_fontAvailable && m_firstFramePainted) {
+    loadFont();
+  }
+
+  m_profiler.beginFrame();
+  m_gpuTimer.collect(m_profiler);
 
-  update();
+  // The time since the last frame, waits included, was spent on that frame
+  m_pacer.account(m_idleFrame,
+                  m_profiler.total(Profiler::Stage::ItemsDrawGPU) +
+                      m_profiler.total(Profiler::Stage::CarDrawGPU));
+  m_idleFrame = idle();
+  if (m_idleFrame && m_awakeFrames == 0) {
+    // The end screen wakes up to restart the round
+    FramePacer::waitForEvent(
+        m_focused ? static_cast<double>(
+                        m_frames.front().m_world.m_secondsToRestart)
+                  : 1.0);
+  }
+  m_awakeFrames = std::max(0, m_awakeFrames - 1);
+  m_pacer.pace();
+
+  const auto drawStart{Profiler::Clock::now()};
+  const auto busyStart{m_simulation.busySeconds(drawStart)};
+  {
+    Profiler::Scope scope{&m_profiler, Profiler::Stage::Update};
+    // Out of focus the simulation pauses, dropping the time spent away
+    const auto paused{idle() && !m_focused};
+    if (m_threadedSimulation) {
+      m_simulation.setPaused(paused);
+    } else if (!paused) {
+      update(static_cast<float>(getDeltaTime()));
+    }
+    acquireFrame();
+  }
+  if (m_replayEnded) finishReplay();
+
+  const auto &frame{m_frames.front()};
+  const auto &world{frame.m_world};
+  const auto interpolation{std::clamp(
+      std::chrono::duration<float>(Profiler::Clock::now() - frame.m_tickEnd)
+              .count() *
+          frame.m_tickRate,
+      0.0f, 1.0f)};
 
-  abcg::glClear(GL_COLOR_BUFFER_BIT);
   abcg::glViewport(0, 0, m_viewportWidth, m_viewportHeight);
-  m_items.paintGL();
-  m_car.paintGL(m_gameData);
+  m_renderQueue.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                      glm::vec4{gsl::at(m_clearColor, 0),
+                                gsl::at(m_clearColor, 1),
+                                gsl::at(m_clearColor, 2),
+                                gsl::at(m_clearColor, 3)});
+  {
+    Profiler::Scope scope{&m_profiler, Profiler::Stage::ItemsPaint};
+    const auto &items{m_threadedSimulation ? world.m_items : m_world.items()};
+#if !defined(__EMSCRIPTEN__)
+    if (m_world.itemsMotion() != nullptr) {
+      m_itemsRenderer.paintFeedback(m_itemsFeedback, m_renderQueue,
+                                    interpolation);
+    } else {
+      m_itemsRenderer.paintGL(items, world.m_car.m_translation, m_stream,
+                              m_renderQueue, interpolation);
+    }
+#else
+    m_itemsRenderer.paintGL(items, world.m_car.m_translation, m_stream,
+                            m_renderQueue, interpolation);
+#endif
+  }
+  {
+    Profiler::Scope scope{&m_profiler, Profiler::Stage::CarPaint};
+    m_carRenderer.paintGL(world.m_car, world.m_gameData, m_stream,
+                          m_renderQueue, interpolation);
+  }
+  {
+    Profiler::Scope scope{&m_profiler, Profiler::Stage::RenderFlush};
+    m_renderQueue.flush(m_gpuTimer);
+  }
+  m_stream.endFrame();
+
+  const auto drawEnd{Profiler::Clock::now()};
+  while (const auto *press{m_presses.front()}) {
+    if (press->m_tick > frame.m_ticks) break;
+    m_inputLatency.pressPainted(press->m_time, drawEnd);
+    m_presses.pop();
+  }
+  if (m_threadedSimulation) {
+    m_overlap.m_drawing +=
+        std::chrono::duration<double>(drawEnd - drawStart).count();
+    m_overlap.m_shared += m_simulation.busySeconds(drawEnd) - busyStart;
+  }
+
+  if (!m_firstFramePainted) {
+    m_firstFramePainted = true;
+#if defined(__EMSCRIPTEN__)
+    // Time to first frame, from the start of the page navigation
+    fmt::print("First frame at {:.0f} ms\n", emscripten_get_now());
+#endif
+  }
+}
+
+void OpenGLWindow::loadFont() {
+  ImGuiIO &io{ImGui::GetIO()};
+  const auto filename{getAssetsPath() + fontFile};
+  m_font = io.Fonts->AddFontFromFileTTF(filename.c_str(), 45.0f);
+  if (m_font == nullptr) {
+    throw abcg::Exception{abcg::Exception::Runtime("Cannot load font file")};
+  }
+
+  // The backend uploaded the atlas on the first frame, without this font
+  ImGui_ImplOpenGL3_DestroyFontsTexture();
+  ImGui_ImplOpenGL3_CreateFontsTexture();
 }
 
 void OpenGLWindow::paintUI() {
+  Profiler::Scope scope{&m_profiler, Profiler::Stage::PaintUI};
   
   abcg::OpenGLWindow::paintUI();
+  paintProfiler();
  
+  // The World is only read through the last frame, and changed under the
+  // lock of the simulation thread
+  const auto &world{m_frames.front().m_world};
   {   
     ImGui::Begin("!!!!!!!!!!CARRINHO DA COLETA!!!!!!!!!!");    
     ImGui::Text("Escolha a cor do seu plano de fundo e divirta-se :)"); 
     ImGui::ColorEdit3("Background", m_clearColor.data());     
+    ImGui::Checkbox("Instanced items", &m_itemsRenderer.m_instanced);
+    ImGui::Checkbox("Cull tiles", &m_itemsRenderer.m_cullTiles);
+    ImGui::SameLine();
+    ImGui::Checkbox("Point LOD", &m_itemsRenderer.m_pointLod);
+    const auto &cull{m_itemsRenderer.cullStats()};
+    ImGui::Text("Item copies: %zu drawn (%zu as points), %zu culled",
+                cull.drawn, cull.points, cull.culled);
+    ImGui::Text("Stream buffer: %s, %zu KiB per frame",
+                m_stream.persistent() ? "persistent" : "orphaned",
+                m_stream.frameSize() / 1024);
+    const auto &render{m_renderQueue.stats()};
+    ImGui::Text("Draws: %d in %d calls, %d state changes", render.draws,
+                render.drawCalls, render.stateChanges);
+    // Recordings and replays keep the tick rate they started with
+    if (m_recording) {
+      ImGui::Text("Recording to %s", m_options.inputLog.record.c_str());
+    } else if (m_replay) {
+      ImGui::Text("Replay: tick %zu of %zu", m_frames.front().m_replayTick,
+                  m_replay->m_inputs.size());
+    } else {
+      if (auto tickRate{m_frames.front().m_tickRate}; ImGui::SliderFloat(
+              "Tick rate (Hz)", &tickRate, 10.0f, 240.0f, "%.0f")) {
+        const auto lock{m_simulation.lock()};
+        m_tickRate = tickRate;
+      }
+      ImGui::InputInt("Items", &m_items, 100, 10000);
+      m_items = std::clamp(m_items, 0, 1'000'000);
+      ImGui::SameLine();
+      if (ImGui::Button("Restart")) {
+        const auto lock{m_simulation.lock()};
+        m_world.restart(m_items,
+                        static_cast<unsigned int>(std::chrono::steady_clock::now()
+                                                      .time_since_epoch()
+                                                      .count()));
+      }
+      if (ImGui::Button("Save snapshot")) saveSnapshot();
+      ImGui::SameLine();
+      if (ImGui::Button("Load snapshot")) loadSnapshot();
+      if (!m_snapshotStatus.empty()) {
+        ImGui::Text("%s", m_snapshotStatus.c_str());
+      }
+    }
+    if (!m_replayStatus.empty()) ImGui::Text("%s", m_replayStatus.c_str());
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#if !defined(__EMSCRIPTEN__)
+    const auto maxThreads{
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()))};
+#else
+    // A worker beyond the preallocated pthread pool would block the page
+    // while its Web Worker starts
+    const auto maxThreads{CAR_WEB_WORKERS + 1};
+#endif
+    if (auto threads{world.m_threads};
+        ImGui::SliderInt("Threads", &threads, 1, maxThreads)) {
+      const auto lock{m_simulation.lock()};
+      m_world.setThreads(threads);
+    }
+#endif
+#if !defined(__EMSCRIPTEN__)
+    if (auto threaded{m_threadedSimulation};
+        ImGui::Checkbox("Simulation thread", &threaded)) {
+      setThreadedSimulation(threaded);
+    }
+    ImGui::SameLine();
+    if (ImGui::Checkbox("GPU item motion", &m_gpuMotion)) {
+      if (m_gpuMotion) setThreadedSimulation(false);
+      m_world.setItemsMotion(m_gpuMotion ? &m_itemsFeedback : nullptr);
+    }
+#endif
+    const auto &pool{world.m_pool};
+    ImGui::Text("Item pool: %zu/%zu live, peak %zu", pool.live, pool.capacity,
+                pool.highWater);
+    ImGui::Text("Allocations: %d last frame, %d total", m_frameAllocations,
+                pool.allocations);
+    ImGui::Text("Round %d, last restart %.3f ms", world.m_rounds,
+                world.m_lastRestartSeconds * 1e3);
+    paintPacing();
     ImGui::End();    
   }
 
@@ -147,64 +625,171 @@ void OpenGLWindow::paintUI() {
     ImGui::Begin(" ", nullptr, flags);
     ImGui::PushFont(m_font);
 
-    if (m_gameData.m_state == State::Win) {
-      ImGui::Text("Você coletou: %d itens!!", m_objects);
+    if (world.m_gameData.m_state == State::Win) {
+      ImGui::Text("Você coletou: %d itens!!", world.m_objects);
     }
     ImGui::PopFont();
     ImGui::End();
   }
 }
 
+// Rolling timings of the last frames, and export of the recorded ones
+void OpenGLWindow::paintPacing() {
+#if !defined(__EMSCRIPTEN__)
+  if (auto fps{m_pacer.maxFps()};
+      ImGui::SliderInt("FPS cap", &fps, 0, 240, fps == 0 ? "off" : "%d")) {
+    m_pacer.setMaxFps(fps);
+  }
+  const char *const vSyncModes[]{"Off", "On", "Adaptive"};
+  if (auto mode{static_cast<int>(m_pacer.vSync())};
+      ImGui::Combo("VSync", &mode, vSyncModes, 3)) {
+    m_pacer.setVSync(static_cast<FramePacer::VSync>(mode));
+  }
+#endif
+  ImGui::Checkbox("Idle when possible", &m_idleEnabled);
+
+  // Per second of each kind of frame, and what the idle frames saved over
+  // running as the active ones do
+  const auto &active{m_pacer.active()};
+  const auto &idle{m_pacer.idle()};
+  const auto rate{[](double used, double wall) {
+    return wall > 0.0 ? used / wall : 0.0;
+  }};
+  ImGui::Text("Active %.0f s: CPU %.0f%%, GPU %.1f ms/s", active.wall,
+              rate(active.cpu, active.wall) * 100.0,
+              rate(active.gpu, active.wall) * 1e3);
+  ImGui::Text("Idle %.0f s: CPU %.0f%%, GPU %.1f ms/s", idle.wall,
+              rate(idle.cpu, idle.wall) * 100.0,
+              rate(idle.gpu, idle.wall) * 1e3);
+  ImGui::Text("Idling saved %.1f s of CPU, %.2f s of GPU",
+              std::max(0.0, idle.wall * rate(active.cpu, active.wall) -
+                                idle.cpu),
+              std::max(0.0, idle.wall * rate(active.gpu, active.wall) -
+                                idle.gpu));
+}
+
+void OpenGLWindow::paintProfiler() {
+  ImGui::SetNextWindowPos(ImVec2(m_viewportWidth - 330.0f, 5.0f),
+                          ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowSize(ImVec2(325, 270), ImGuiCond_FirstUseEver);
+  ImGui::Begin("Profiler");
+
+  ImGui::Text("%-18s %7s %7s %7s", "ms", "min", "avg", "p99");
+  for (auto stage : iter::range(Profiler::stageCount)) {
+    const auto id{static_cast<Profiler::Stage>(stage)};
+    const auto summary{m_profiler.summary(id)};
+    ImGui::Text("%-18s %7.3f %7.3f %7.3f", Profiler::name(id), summary.min,
+                summary.avg, summary.p99);
+  }
+  // From a press to the end of the first frame that simulated it
+  const auto latency{m_inputLatency.summary()};
+  ImGui::Text("input latency: last %.1f, avg %.1f, max %.1f ms", latency.last,
+              latency.avg, latency.max);
+  ImGui::Text("input events dropped: %d",
+              m_droppedInputs.load(std::memory_order_relaxed));
+  if (m_threadedSimulation) {
+    // Per second on each thread, and the share of the simulation that ran
+    // while paintGL was drawing
+    const auto now{Profiler::Clock::now()};
+    const auto wall{
+        std::chrono::duration<double>(now - m_overlap.m_start).count()};
+    const auto simulation{m_simulation.busySeconds(now)};
+    ImGui::Text("sim thread %.1f ms/s, drawing %.1f ms/s, %.0f%% overlap",
+                wall > 0.0 ? simulation / wall * 1e3 : 0.0,
+                wall > 0.0 ? m_overlap.m_drawing / wall * 1e3 : 0.0,
+                simulation > 0.0 ? m_overlap.m_shared / simulation * 100.0
+                                 : 0.0);
+  }
+
+  if (auto recording{m_profiler.recording()};
+      ImGui::Checkbox("Record", &recording)) {
+    if (recording) m_profiler.clearRecording();
+    m_profiler.setRecording(recording);
+  }
+  ImGui::SameLine();
+  ImGui::Text("%zu frames", m_profiler.recordedFrames());
+
+  const auto save{[this](const char *label, auto write, const char *path) {
+    if (!ImGui::Button(label)) return;
+    try {
+      (m_profiler.*write)(path);
+      m_profilerStatus = fmt::format("Saved {}", path);
+    } catch (const std::exception &exception) {
+      m_profilerStatus = exception.what();
+    }
+  }};
+  save("Save CSV", &Profiler::writeCsv, "profile.csv");
+  ImGui::SameLine();
+  save("Save trace", &Profiler::writeChromeTrace, "profile.json");
+  ImGui::Text("%s", m_profilerStatus.c_str());
+
+  ImGui::End();
+}
+
+// Stops the simulation on the last recorded tick, so that the final state
+// and the recorded frame times can be compared
+void OpenGLWindow::finishReplay() {
+  const auto lock{m_simulation.lock()};
+  m_replayEnded = false;
+  // The checksum needs the item state back from the GPU
+#if !defined(__EMSCRIPTEN__)
+  m_gpuMotion = false;
+  m_world.setItemsMotion(nullptr);
+#endif
+
+  const auto same{m_world.checksum() == m_replay->m_checksum};
+  m_replayStatus = fmt::format("Replay finished after {} ticks, {}",
+                               m_replay->m_inputs.size(),
+                               same ? "same state as recorded"
+                                    : "state DIFFERS from the recording");
+  fmt::print("{}\n", m_replayStatus);
+
+  const auto frame{m_profiler.summary(Profiler::Stage::Frame)};
+  fmt::print("frame time over the last {} frames: min {:.3f} ms, avg {:.3f} "
+             "ms, p99 {:.3f} ms\n",
+             std::min(m_profiler.recordedFrames(), Profiler::window),
+             frame.min, frame.avg, frame.p99);
+
+  m_profiler.setRecording(false);
+  m_replay.reset();
+  m_replayFinished = true;
+}
+
 void OpenGLWindow::resizeGL(int width, int height) {
   m_viewportWidth = width;
   m_viewportHeight = height;
 
    abcg::glClear(GL_COLOR_BUFFER_BIT);
+  m_itemsRenderer.resizeGL(width, height);
 }
 
 void OpenGLWindow::terminateGL() {    
-  glDeleteBuffers(1, &m_vboVertices);
-  glDeleteBuffers(1, &m_vboColors);
-  glDeleteVertexArrays(1, &m_vao);
-  abcg::glDeleteProgram(m_objectsProgram);
-  m_car.terminateGL();
-  m_items.terminateGL();
-}
-
-void OpenGLWindow::checkCollisions() {  
-  for ( auto &item : m_items.m_items) {
-    const auto itemTranslation{item.m_translation};
-    const auto distance{
-        glm::distance(m_car.m_translation, itemTranslation)};
-
-    if (distance < m_car.m_scale * 0.9f + item.m_scale * 0.85f) {
-      item.m_hit = true;
-      m_objects++;      
-    }
-  } 
-
-    for (auto &item : m_items.m_items) {
-      if (item.m_hit && item.m_scale > 0.10f) {
-        std::uniform_real_distribution<float> m_randomDist{-1.0f, 1.0f};
-        std::generate_n(std::back_inserter(m_items.m_items), 3, [&]() {
-          const glm::vec2 offset{m_randomDist(m_randomEngine),
-                                 m_randomDist(m_randomEngine)};
-          return m_items.createItem(
-              item.m_translation + offset * item.m_scale * 0.5f,
-              item.m_scale * 0.5f);
-        });
-      }
+  setThreadedSimulation(false);
+#if !defined(__EMSCRIPTEN__)
+  m_world.setItemsMotion(nullptr);
+#endif
+  if (m_recording) {
+    m_recording->m_checksum = m_world.checksum();
+    try {
+      m_recording->save(m_options.inputLog.record);
+      fmt::print("Recorded {} ticks to {}\n", m_recording->m_inputs.size(),
+                 m_options.inputLog.record);
+    } catch (const std::exception &exception) {
+      fmt::print(stderr, "{}\n", exception.what());
     }
-
-    m_items.m_items.remove_if(
-        []( Items::Item &a) { return a.m_hit; });
+    m_recording.reset();
   }
 
-
-void OpenGLWindow::checkWinCondition() {
-  if (m_timerGame.elapsed() > 10) {
-    m_gameData.m_state = State::Win;
-    m_restartWaitTimer.restart();    
-  }  
+  abcg::glDeleteProgram(m_objectsProgram);
+  abcg::glDeleteProgram(m_carProgram);
+  abcg::glDeleteProgram(m_itemsProgram);
+  abcg::glDeleteProgram(m_itemsPointsProgram);
+  abcg::glDeleteProgram(m_itemsFeedbackProgram);
+  m_carRenderer.terminateGL();
+  m_itemsRenderer.terminateGL();
+  m_gpuTimer.terminateGL();
+  m_stream.terminateGL();
+#if !defined(__EMSCRIPTEN__)
+  m_itemsFeedback.terminateGL();
+#endif
 }
-
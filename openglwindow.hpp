@@ -2,15 +2,56 @@
 #define OPENGLWINDOW_HPP_
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <imgui.h>
-
-#include <random>
+#include <optional>
+#include <string>
 
 #include "abcg.hpp"
-#include "car.hpp"
-#include "items.hpp"
+#include "carrenderer.hpp"
+#include "framepacer.hpp"
+#include "gputimer.hpp"
+#include "inputlatency.hpp"
+#include "inputlog.hpp"
+#include "inputqueue.hpp"
+#include "itemsfeedback.hpp"
+#include "itemsrenderer.hpp"
+#include "profiler.hpp"
+#include "renderqueue.hpp"
+#include "simulationthread.hpp"
+#include "snapshot.hpp"
+#include "spscqueue.hpp"
+#include "streambuffer.hpp"
+#include "triplebuffer.hpp"
+#include "world.hpp"
+
+// Window mode options: car [--items N] [--fps N] [--vsync off|on|adaptive]
+// [--no-idle] [--no-sim-thread]
+// [--record FILE | --replay FILE | --snapshot FILE]
+// --snapshot resumes the game saved in FILE, which the Save and Load
+// buttons then use instead of car.snapshot. --no-sim-thread runs the
+// simulation in paintGL, between the frames, instead of on its own thread
+struct WindowOptions {
+  int items{100};
+  std::string snapshot;
+  int maxFps{};
+  FramePacer::VSync vSync{FramePacer::VSync::Off};
+  bool idle{true};
+  bool simulationThread{true};
+  InputLogOptions inputLog;
+};
+
+WindowOptions parseWindowOptions(int argc, char **argv);
 
 class OpenGLWindow : public abcg::OpenGLWindow {
+ public:
+  void setOptions(const WindowOptions &options) {
+    m_options = options;
+    m_items = options.items;
+    m_idleEnabled = options.idle;
+  }
+
  protected:
  void handleEvent(SDL_Event& event) override;
   void initializeGL() override;
@@ -20,30 +61,129 @@ class OpenGLWindow : public abcg::OpenGLWindow {
   void terminateGL() override;
 
  private:
-  GLuint m_vao{};
-  GLuint m_vboVertices{};
-  GLuint m_vboColors{};  
   GLuint m_objectsProgram{};
+  GLuint m_carProgram{};
+  GLuint m_itemsProgram{};
+  GLuint m_itemsPointsProgram{};
+  GLuint m_itemsFeedbackProgram{};
 
   int m_viewportWidth{};
   int m_viewportHeight{};
 
-  GameData m_gameData; 
+  World m_world;
+
+  CarRenderer m_carRenderer;
+  ItemsRenderer m_itemsRenderer;
 
-  Car m_car;
-  Items m_items;
+  // Per-frame instance data of the car and the instanced items
+  StreamBuffer m_stream;
+  RenderQueue m_renderQueue;
 
-  abcg::ElapsedTimer m_restartWaitTimer;
-  abcg::ElapsedTimer m_timerGame;
+#if !defined(__EMSCRIPTEN__)
+  // Item motion on the GPU through transform feedback, off by default
+  ItemsFeedback m_itemsFeedback;
+  bool m_gpuMotion{false};
+#endif
 
+  // The 45 px game-over font. Its atlas is built by loadFont() after the
+  // first frame, so that it does not delay it. The fast web build also
+  // fetches the font file only then, instead of preloading it
   ImFont* m_font{};
+  bool m_fontAvailable{};
+  bool m_firstFramePainted{};
+  void loadFont();
+
+  float update(float deltaTime);
+  void publishFrame(InputQueue::Clock::time_point tickEnd);
+  void acquireFrame();
+  void setThreadedSimulation(bool threaded);
+  void saveSnapshot();
+  void loadSnapshot();
+  void createItemMeshes();
+  [[nodiscard]] bool idle() const;
+  void paintProfiler();
+  void paintPacing();
+  void finishReplay();
+
+  Profiler m_profiler;
+  GpuTimer m_gpuTimer;
+  std::string m_profilerStatus;
+
+  // Fixed-timestep simulation: update() runs as many ticks as the elapsed
+  // time allows, up to m_maxTicksPerFrame, and paintGL renders between the
+  // last two states
+  float m_tickRate{60.0f};
+  int m_maxTicksPerFrame{5};
+  float m_tickAccumulator{};
+  std::uint64_t m_ticks{};
+
+  // update() runs on m_simulation, which then owns m_world and everything
+  // update() touches, or in paintGL without the thread. After its ticks it
+  // publishes what drawing and the UI read, and paintGL draws the newest
+  // one. Without the thread, the items are drawn from m_world instead
+  struct Frame {
+    World::Frame m_world;
+    std::uint64_t m_ticks{};
+    // Where the last tick ends, and so where interpolation starts from
+    InputQueue::Clock::time_point m_tickEnd;
+    float m_tickRate{60.0f};
+    std::size_t m_replayTick{};
+  };
+  SimulationThread m_simulation;
+  bool m_threadedSimulation{};
+  TripleBuffer<Frame> m_frames;
+  World::StageTimes m_drawnStageTimes;
+  int m_drawnAllocations{};
+
+  // Simulation time that ran while paintGL was drawing, since the thread
+  // started
+  struct Overlap {
+    InputQueue::Clock::time_point m_start;
+    double m_drawing{};
+    double m_shared{};
+  };
+  Overlap m_overlap;
+
+  // Item pool allocations made by the ticks of the last frame
+  int m_frameAllocations{};
+
+  // Frames are capped by the pacer. While idle, on the end screen or out of
+  // focus, a frame first waits for an event, and out of focus the
+  // simulation pauses. Any event keeps the next few frames awake
+  FramePacer m_pacer;
+  bool m_idleEnabled{true};
+  bool m_focused{true};
+  bool m_idleFrame{};
+  int m_awakeFrames{};
 
-  std::default_random_engine m_randomEngine;
+  // Item count of the next restart from the UI
+  int m_items{100};
 
-  void checkCollisions();
-  void checkWinCondition();
-  void restart();
-  void update();
+  // Input of every tick is either recorded, or replayed from a log instead
+  // of taken from events
+  WindowOptions m_options;
+  InputQueue m_inputQueue;
+  // Events from handleEvent to update(), and presses consumed by a tick to
+  // the first frame that draws it
+  SpscQueue<InputQueue::Event, 256> m_inputEvents;
+  // Keys held as of the last event, and events a full queue dropped. The
+  // ticks catch up with the keys held after every drop
+  std::atomic<std::uint8_t> m_heldInputs{};
+  std::atomic<int> m_droppedInputs{};
+  int m_reconciledDrops{};
+  struct Press {
+    std::uint64_t m_tick{};
+    InputQueue::Clock::time_point m_time;
+  };
+  SpscQueue<Press, 64> m_presses;
+  InputLatency m_inputLatency;
+  std::atomic<bool> m_replayEnded{};
+  std::optional<InputLog> m_recording;
+  std::optional<InputLog> m_replay;
+  std::size_t m_replayTick{};
+  bool m_replayFinished{};
+  std::string m_replayStatus;
+  std::string m_snapshotStatus;
 
   std::array<float, 4> m_clearColor{0.906f, 0.910f, 0.918f, 1.00f};
 };
@@ -0,0 +1,173 @@
+#include "philox.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr std::uint32_t multiplier0{0xD2511F53};
+constexpr std::uint32_t multiplier1{0xCD9E8D57};
+constexpr std::uint32_t weyl0{0x9E3779B9};
+constexpr std::uint32_t weyl1{0xBB67AE85};
+constexpr int rounds{10};
+
+constexpr std::uint32_t low(std::uint64_t value) {
+  return static_cast<std::uint32_t>(value);
+}
+
+constexpr std::uint32_t high(std::uint64_t value) {
+  return static_cast<std::uint32_t>(value >> 32);
+}
+
+}  // namespace
+
+void Philox::seed(std::uint64_t seed, std::uint64_t stream) {
+  m_key = {low(seed), high(seed)};
+  m_stream = stream;
+  m_position = 0;
+  m_blockIndex = ~std::uint64_t{};
+}
+
+void Philox::setState(const State &state) {
+  m_key = state.key;
+  m_stream = state.stream;
+  m_position = state.position;
+  m_blockIndex = ~std::uint64_t{};
+}
+
+std::uint32_t Philox::next() {
+  const auto index{m_position / 4};
+  if (index != m_blockIndex) {
+    m_block = block(index);
+    m_blockIndex = index;
+  }
+  return m_block.at(m_position++ % 4);
+}
+
+float Philox::uniform(float min, float max) {
+  return toUniform(next(), min, max);
+}
+
+int Philox::uniformInt(int min, int max) {
+  return toUniformInt(next(), min, max);
+}
+
+void Philox::fill(std::span<std::uint32_t> out) {
+  fillAt(m_position, out);
+  skip(out.size());
+}
+
+void Philox::fillUniform(std::span<float> out, float min, float max) {
+  fillUniformAt(m_position, out, min, max);
+  skip(out.size());
+}
+
+void Philox::fillUniformInt(std::span<int> out, int min, int max) {
+  fillUniformIntAt(m_position, out, min, max);
+  skip(out.size());
+}
+
+void Philox::fillAt(std::uint64_t first,
+                    std::span<std::uint32_t> out) const {
+  generateAt(first, out, [](std::uint32_t bits) { return bits; });
+}
+
+void Philox::fillUniformAt(std::uint64_t first, std::span<float> out,
+                           float min, float max) const {
+  generateAt(first, out, [min, max](std::uint32_t bits) {
+    return toUniform(bits, min, max);
+  });
+}
+
+void Philox::fillUniformIntAt(std::uint64_t first, std::span<int> out,
+                              int min, int max) const {
+  generateAt(first, out, [min, max](std::uint32_t bits) {
+    return toUniformInt(bits, min, max);
+  });
+}
+
+Philox::Block Philox::generate(Block counter,
+                               std::array<std::uint32_t, 2> key) {
+  for (auto round{0}; round < rounds; ++round) {
+    const auto product0{std::uint64_t{multiplier0} * counter[0]};
+    const auto product1{std::uint64_t{multiplier1} * counter[2]};
+    counter = {high(product1) ^ counter[1] ^ key[0], low(product1),
+               high(product0) ^ counter[3] ^ key[1], low(product0)};
+    key[0] += weyl0;
+    key[1] += weyl1;
+  }
+  return counter;
+}
+
+Philox::Block Philox::block(std::uint64_t index) const {
+  return generate({low(index), high(index), low(m_stream), high(m_stream)},
+                  m_key);
+}
+
+// Blocks [index, index + batchBlocks) side by side, one array per word, so
+// that the compiler can run the rounds of several blocks in SIMD lanes.
+// Value i of the batch lands in out[i]
+void Philox::generateBatch(std::uint64_t index, Batch &out) const {
+  std::array<std::uint32_t, batchBlocks> word0{};
+  std::array<std::uint32_t, batchBlocks> word1{};
+  std::array<std::uint32_t, batchBlocks> word2{};
+  std::array<std::uint32_t, batchBlocks> word3{};
+  for (std::size_t block{}; block < batchBlocks; ++block) {
+    word0[block] = low(index + block);
+    word1[block] = high(index + block);
+    word2[block] = low(m_stream);
+    word3[block] = high(m_stream);
+  }
+
+  auto key{m_key};
+  for (auto round{0}; round < rounds; ++round) {
+    for (std::size_t block{}; block < batchBlocks; ++block) {
+      const auto product0{std::uint64_t{multiplier0} * word0[block]};
+      const auto product1{std::uint64_t{multiplier1} * word2[block]};
+      word0[block] = high(product1) ^ word1[block] ^ key[0];
+      word1[block] = low(product1);
+      word2[block] = high(product0) ^ word3[block] ^ key[1];
+      word3[block] = low(product0);
+    }
+    key[0] += weyl0;
+    key[1] += weyl1;
+  }
+
+  for (std::size_t block{}; block < batchBlocks; ++block) {
+    out[4 * block] = word0[block];
+    out[4 * block + 1] = word1[block];
+    out[4 * block + 2] = word2[block];
+    out[4 * block + 3] = word3[block];
+  }
+}
+
+template <typename Convert, typename T>
+void Philox::generateAt(std::uint64_t first, std::span<T> out,
+                        Convert convert) const {
+  Batch values{};
+  std::size_t written{};
+  auto index{first / 4};
+  auto lane{static_cast<std::size_t>(first % 4)};
+  while (written < out.size()) {
+    generateBatch(index, values);
+    index += batchBlocks;
+    const auto count{std::min(values.size() - lane, out.size() - written)};
+    for (std::size_t value{}; value < count; ++value) {
+      out[written + value] = convert(values[lane + value]);
+    }
+    written += count;
+    lane = 0;
+  }
+}
+
+// The top 24 bits, which a float keeps exactly
+float Philox::toUniform(std::uint32_t bits, float min, float max) {
+  const auto unit{static_cast<float>(bits >> 8) * 0x1.0p-24f};
+  return min + (max - min) * unit;
+}
+
+// Multiply-shift instead of a modulo; the bias is below 2^-32 per value
+int Philox::toUniformInt(std::uint32_t bits, int min, int max) {
+  const auto range{static_cast<std::uint64_t>(
+      static_cast<std::int64_t>(max) - min + 1)};
+  return min + static_cast<int>((range * bits) >> 32);
+}
@@ -0,0 +1,84 @@
+#ifndef PHILOX_HPP_
+#define PHILOX_HPP_
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3"). Value i of a sequence is a pure
+// function of the seed, the stream and i, so a sequence can be filled in
+// chunks by several threads through the const *At() calls, with the same
+// result as one sequential fill. Different streams of a seed do not overlap
+class Philox {
+ public:
+  Philox() = default;
+  explicit Philox(std::uint64_t seed, std::uint64_t stream = 0) {
+    this->seed(seed, stream);
+  }
+
+  // Restarts at position 0 of the given sequence
+  void seed(std::uint64_t seed, std::uint64_t stream = 0);
+
+  [[nodiscard]] std::uint32_t next();
+  // In [min, max)
+  [[nodiscard]] float uniform(float min, float max);
+  // In [min, max]
+  [[nodiscard]] int uniformInt(int min, int max);
+
+  // The next out.size() values, the same that as many calls above would
+  // give
+  void fill(std::span<std::uint32_t> out);
+  void fillUniform(std::span<float> out, float min, float max);
+  void fillUniformInt(std::span<int> out, int min, int max);
+
+  // Values at positions [first, first + out.size()), leaving the position
+  // alone
+  void fillAt(std::uint64_t first, std::span<std::uint32_t> out) const;
+  void fillUniformAt(std::uint64_t first, std::span<float> out, float min,
+                     float max) const;
+  void fillUniformIntAt(std::uint64_t first, std::span<int> out, int min,
+                        int max) const;
+
+  // Moves past count values, as filled by someone else
+  void skip(std::uint64_t count) { m_position += count; }
+  [[nodiscard]] std::uint64_t position() const { return m_position; }
+
+  // Everything the sequence depends on, to save a generator and resume it
+  struct State {
+    std::array<std::uint32_t, 2> key;
+    std::uint64_t stream;
+    std::uint64_t position;
+  };
+  [[nodiscard]] State state() const { return {m_key, m_stream, m_position}; }
+  void setState(const State &state);
+
+  // One block of the raw generator
+  using Block = std::array<std::uint32_t, 4>;
+  [[nodiscard]] static Block generate(Block counter,
+                                      std::array<std::uint32_t, 2> key);
+
+ private:
+  std::array<std::uint32_t, 2> m_key{};
+  std::uint64_t m_stream{};
+  std::uint64_t m_position{};
+
+  // Last block computed by next(), and its index
+  Block m_block{};
+  std::uint64_t m_blockIndex{~std::uint64_t{}};
+
+  static constexpr std::size_t batchBlocks{32};
+  using Batch = std::array<std::uint32_t, 4 * batchBlocks>;
+
+  [[nodiscard]] Block block(std::uint64_t index) const;
+  void generateBatch(std::uint64_t index, Batch &out) const;
+  template <typename Convert, typename T>
+  void generateAt(std::uint64_t first, std::span<T> out,
+                  Convert convert) const;
+
+  [[nodiscard]] static float toUniform(std::uint32_t bits, float min,
+                                       float max);
+  [[nodiscard]] static int toUniformInt(std::uint32_t bits, int min, int max);
+};
+
+#endif
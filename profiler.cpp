@@ -0,0 +1,152 @@
+#include "profiler.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+using File = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+File open(const std::string &path) {
+  File file{std::fopen(path.c_str(), "w"), &std::fclose};
+  if (!file) {
+    throw std::runtime_error{fmt::format("Cannot write {}", path)};
+  }
+  return file;
+}
+
+}  // namespace
+
+const char *Profiler::name(Stage stage) {
+  switch (stage) {
+    case Stage::Frame:
+      return "frame";
+    case Stage::Update:
+      return "update";
+    case Stage::ItemsUpdate:
+      return "items update";
+    case Stage::Collisions:
+      return "collisions";
+    case Stage::ItemsPaint:
+      return "items paint";
+    case Stage::CarPaint:
+      return "car paint";
+    case Stage::RenderFlush:
+      return "render flush";
+    case Stage::PaintUI:
+      return "paint UI";
+    case Stage::ItemsDrawGPU:
+      return "items draw (GPU)";
+    case Stage::CarDrawGPU:
+      return "car draw (GPU)";
+    case Stage::Count:
+      break;
+  }
+  return "";
+}
+
+Profiler::Scope::Scope(Profiler *profiler, Stage stage)
+    : m_profiler{profiler}, m_stage{stage} {
+  if (m_profiler != nullptr) m_start = Clock::now();
+}
+
+Profiler::Scope::~Scope() {
+  if (m_profiler == nullptr) return;
+  const std::chrono::duration<double> elapsed{Clock::now() - m_start};
+  m_profiler->add(m_stage, m_start, elapsed.count());
+}
+
+void Profiler::beginFrame() {
+  const auto now{Clock::now()};
+  if (m_inFrame) {
+    const std::chrono::duration<double> elapsed{now - m_frameStart};
+    add(Stage::Frame, m_frameStart, elapsed.count());
+
+    const auto slot{m_frames % window};
+    std::array<float, stageCount> sample{};
+    for (std::size_t stage = 0; stage < stageCount; ++stage) {
+      sample.at(stage) = static_cast<float>(m_current.at(stage) * 1e3);
+      m_history.at(stage).at(slot) = sample.at(stage);
+    }
+    if (m_recording) m_samples.push_back(sample);
+    ++m_frames;
+  }
+
+  m_current.fill(0.0);
+  m_frameStart = now;
+  m_inFrame = true;
+}
+
+void Profiler::add(Stage stage, Clock::time_point start, double seconds) {
+  m_current.at(static_cast<std::size_t>(stage)) += seconds;
+  m_totals.at(static_cast<std::size_t>(stage)) += seconds;
+  if (m_recording) {
+    const std::chrono::duration<double> offset{start - m_origin};
+    m_events.push_back({stage, offset.count(), seconds});
+  }
+}
+
+Profiler::Summary Profiler::summary(Stage stage) const {
+  const auto count{std::min(m_frames, window)};
+  if (count == 0) return {};
+
+  const auto &history{m_history.at(static_cast<std::size_t>(stage))};
+  m_sorted.assign(history.begin(),
+                  history.begin() + static_cast<std::ptrdiff_t>(count));
+  std::sort(m_sorted.begin(), m_sorted.end());
+
+  double sum{};
+  for (const auto value : m_sorted) sum += value;
+  const auto p99{static_cast<std::size_t>(
+      std::ceil(0.99 * static_cast<double>(count)))};
+  return {m_sorted.front(), sum / static_cast<double>(count),
+          m_sorted.at(p99 - 1)};
+}
+
+void Profiler::clearRecording() {
+  m_samples.clear();
+  m_events.clear();
+}
+
+void Profiler::writeCsv(const std::string &path) const {
+  const auto file{open(path)};
+
+  fmt::print(file.get(), "frame");
+  for (std::size_t stage = 0; stage < stageCount; ++stage) {
+    fmt::print(file.get(), ",{} ms", name(static_cast<Stage>(stage)));
+  }
+  fmt::print(file.get(), "\n");
+
+  for (std::size_t frame = 0; frame < m_samples.size(); ++frame) {
+    fmt::print(file.get(), "{}", frame);
+    for (const auto value : m_samples.at(frame)) {
+      fmt::print(file.get(), ",{:.4f}", value);
+    }
+    fmt::print(file.get(), "\n");
+  }
+}
+
+// GPU stages go on their own track. Their start is when the draw was
+// issued, since GPU and CPU clocks are not synchronized
+void Profiler::writeChromeTrace(const std::string &path) const {
+  const auto file{open(path)};
+
+  fmt::print(file.get(), "{{\"traceEvents\":[\n");
+  for (std::size_t index = 0; index < m_events.size(); ++index) {
+    const auto &event{m_events.at(index)};
+    const auto gpu{event.stage == Stage::ItemsDrawGPU ||
+                   event.stage == Stage::CarDrawGPU};
+    fmt::print(file.get(),
+               "{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+               "\"ts\":{:.3f},\"dur\":{:.3f}}}{}\n",
+               name(event.stage), gpu ? 2 : 1, event.start * 1e6,
+               event.duration * 1e6,
+               index + 1 < m_events.size() ? "," : "");
+  }
+  fmt::print(file.get(), "]}}\n");
+}
@@ -0,0 +1,100 @@
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Per-frame timings of the stages of a frame, kept for the last
+// Profiler::window frames, and optionally recorded in full for export.
+// Stages that run more than once in a frame, such as the simulation
+// ticks, add up
+class Profiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Stage {
+    Frame,
+    Update,
+    ItemsUpdate,
+    Collisions,
+    ItemsPaint,
+    CarPaint,
+    RenderFlush,
+    PaintUI,
+    ItemsDrawGPU,
+    CarDrawGPU,
+    Count
+  };
+  static constexpr std::size_t stageCount{static_cast<std::size_t>(Stage::Count)};
+  static constexpr std::size_t window{240};
+
+  [[nodiscard]] static const char *name(Stage stage);
+
+  // Times its own lifetime. A null profiler makes it a no-op
+  class Scope {
+   public:
+    Scope(Profiler *profiler, Stage stage);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    Profiler *m_profiler;
+    Stage m_stage;
+    Clock::time_point m_start;
+  };
+
+  // Closes the current frame, if any, and starts the next one
+  void beginFrame();
+  void add(Stage stage, Clock::time_point start, double seconds);
+
+  // Over the last frames, in milliseconds
+  struct Summary {
+    double min{};
+    double avg{};
+    double p99{};
+  };
+  [[nodiscard]] Summary summary(Stage stage) const;
+  // Seconds added to stage since the start, recorded or not
+  [[nodiscard]] double total(Stage stage) const {
+    return m_totals.at(static_cast<std::size_t>(stage));
+  }
+
+  void setRecording(bool recording) { m_recording = recording; }
+  [[nodiscard]] bool recording() const { return m_recording; }
+  [[nodiscard]] std::size_t recordedFrames() const { return m_samples.size(); }
+  void clearRecording();
+
+  // Recorded frames as one row of stage times per frame, or as every
+  // recorded stage run for chrome://tracing. Throw std::runtime_error when
+  // the file cannot be written
+  void writeCsv(const std::string &path) const;
+  void writeChromeTrace(const std::string &path) const;
+
+ private:
+  struct Event {
+    Stage stage;
+    double start;
+    double duration;
+  };
+
+  std::array<std::array<float, window>, stageCount> m_history{};
+  std::size_t m_frames{};
+  std::array<double, stageCount> m_current{};
+  std::array<double, stageCount> m_totals{};
+  bool m_inFrame{};
+
+  Clock::time_point m_origin{Clock::now()};
+  Clock::time_point m_frameStart;
+
+  bool m_recording{};
+  std::vector<std::array<float, stageCount>> m_samples;
+  std::vector<Event> m_events;
+
+  mutable std::vector<float> m_sorted;
+};
+
+#endif
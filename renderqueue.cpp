@@ -0,0 +1,211 @@
+#include "renderqueue.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <tuple>
+
+void RenderQueue::clear(GLbitfield mask, const glm::vec4 &color) {
+  m_clearMask |= mask;
+  m_clearColor = color;
+}
+
+void RenderQueue::submit(const Draw &draw) {
+  m_commands.push_back({draw, noUniforms});
+}
+
+void RenderQueue::submit(const Draw &draw, const ObjectUniforms &uniforms) {
+  m_commands.push_back({draw, static_cast<std::uint32_t>(m_uniforms.size())});
+  m_uniforms.push_back(uniforms);
+}
+
+void RenderQueue::flush(GpuTimer &timer) {
+  m_stats = {};
+  m_stats.draws = static_cast<int>(m_commands.size());
+
+  if (m_clearMask != 0) {
+    abcg::glClearColor(m_clearColor.r, m_clearColor.g, m_clearColor.b,
+                       m_clearColor.a);
+    abcg::glClear(m_clearMask);
+    m_clearMask = 0;
+  }
+
+  // The submission index breaks ties, so that draws sharing all state keep
+  // their order
+  m_order.resize(m_commands.size());
+  std::iota(m_order.begin(), m_order.end(), 0);
+  std::sort(m_order.begin(), m_order.end(),
+            [this](std::uint32_t lhs, std::uint32_t rhs) {
+              const auto &a{m_commands[lhs].m_draw};
+              const auto &b{m_commands[rhs].m_draw};
+              return std::tie(a.m_layer, a.m_program, a.m_vao, a.m_texture,
+                              a.m_blend, lhs) <
+                     std::tie(b.m_layer, b.m_program, b.m_vao, b.m_texture,
+                              b.m_blend, rhs);
+            });
+
+  std::optional<Profiler::Stage> stage;
+  for (std::size_t begin = 0; begin < m_order.size();) {
+    const auto &draw{m_commands[m_order[begin]].m_draw};
+    if (const auto next{gpuStage(draw.m_layer)}; stage != next) {
+      if (stage) timer.end();
+      timer.begin(next);
+      stage = next;
+    }
+
+    apply(draw);
+    const auto end{batchEnd(begin)};
+    issue(begin, end);
+    begin = end;
+  }
+  if (stage) timer.end();
+
+  apply({});
+  m_commands.clear();
+  m_uniforms.clear();
+}
+
+void RenderQueue::apply(const Draw &draw) {
+  if (draw.m_program != m_program) {
+    abcg::glUseProgram(draw.m_program);
+    m_program = draw.m_program;
+    ++m_stats.stateChanges;
+  }
+  if (draw.m_vao != m_vao) {
+    abcg::glBindVertexArray(draw.m_vao);
+    m_vao = draw.m_vao;
+    ++m_stats.stateChanges;
+  }
+#if !defined(__EMSCRIPTEN__)
+  if (draw.m_texture != m_texture) {
+    abcg::glActiveTexture(GL_TEXTURE0);
+    abcg::glBindTexture(GL_TEXTURE_BUFFER, draw.m_texture);
+    m_texture = draw.m_texture;
+    ++m_stats.stateChanges;
+  }
+#endif
+  if (draw.m_blend != m_blend) {
+    if (draw.m_blend) {
+      abcg::glEnable(GL_BLEND);
+      abcg::glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+      abcg::glDisable(GL_BLEND);
+    }
+    m_blend = draw.m_blend;
+    ++m_stats.stateChanges;
+  }
+}
+
+void RenderQueue::setUniforms(GLuint program,
+                              const ObjectUniforms &uniforms) {
+  auto found{std::find_if(m_locations.begin(), m_locations.end(),
+                          [program](const auto &locations) {
+                            return locations.m_program == program;
+                          })};
+  if (found == m_locations.end()) {
+    m_locations.push_back(
+        {program, abcg::glGetUniformLocation(program, "rotation"),
+         abcg::glGetUniformLocation(program, "scale"),
+         abcg::glGetUniformLocation(program, "translation"),
+         abcg::glGetAttribLocation(program, "inColor")});
+    found = std::prev(m_locations.end());
+  }
+
+  abcg::glUniform1f(found->m_rotation, uniforms.m_rotation);
+  abcg::glUniform1f(found->m_scale, uniforms.m_scale);
+  abcg::glUniform2fv(found->m_translation, 1, &uniforms.m_translation.x);
+  if (found->m_color >= 0) {
+    abcg::glVertexAttrib4fv(static_cast<GLuint>(found->m_color),
+                            &uniforms.m_color.r);
+  }
+}
+
+// Draws with uniforms or instances go alone. Others extend the batch while
+// the next draw has the same state and kind
+std::size_t RenderQueue::batchEnd(std::size_t begin) const {
+  const auto &first{m_commands[m_order[begin]]};
+  const auto plain{[](const Command &command) {
+    return command.m_uniforms == noUniforms && command.m_draw.m_instances <= 1;
+  }};
+  if (!plain(first)) return begin + 1;
+
+  const auto &a{first.m_draw};
+  auto end{begin + 1};
+  while (end < m_order.size()) {
+    const auto &command{m_commands[m_order[end]]};
+    const auto &b{command.m_draw};
+    if (!plain(command) || b.m_layer != a.m_layer ||
+        b.m_program != a.m_program || b.m_vao != a.m_vao ||
+        b.m_texture != a.m_texture || b.m_blend != a.m_blend ||
+        b.m_mode != a.m_mode || b.m_indexed != a.m_indexed) {
+      break;
+    }
+    ++end;
+  }
+  return end;
+}
+
+void RenderQueue::issue(std::size_t begin, std::size_t end) {
+  const auto &command{m_commands[m_order[begin]]};
+  const auto &draw{command.m_draw};
+
+  if (end - begin == 1) {
+    if (command.m_uniforms != noUniforms) {
+      setUniforms(draw.m_program, m_uniforms[command.m_uniforms]);
+    }
+    const auto *offset{reinterpret_cast<const void *>(draw.m_indexOffset)};
+    if (draw.m_indexed && draw.m_instances > 1) {
+      abcg::glDrawElementsInstanced(draw.m_mode, draw.m_count,
+                                    GL_UNSIGNED_INT, offset,
+                                    draw.m_instances);
+    } else if (draw.m_indexed) {
+      abcg::glDrawElements(draw.m_mode, draw.m_count, GL_UNSIGNED_INT,
+                           offset);
+    } else if (draw.m_instances > 1) {
+      abcg::glDrawArraysInstanced(draw.m_mode, draw.m_first, draw.m_count,
+                                  draw.m_instances);
+    } else {
+      abcg::glDrawArrays(draw.m_mode, draw.m_first, draw.m_count);
+    }
+    ++m_stats.drawCalls;
+    return;
+  }
+
+  m_firsts.clear();
+  m_counts.clear();
+  m_offsets.clear();
+  for (auto index = begin; index < end; ++index) {
+    const auto &batched{m_commands[m_order[index]].m_draw};
+    m_firsts.push_back(batched.m_first);
+    m_counts.push_back(batched.m_count);
+    m_offsets.push_back(reinterpret_cast<const void *>(batched.m_indexOffset));
+  }
+
+  // WebGL 2 has no multi-draw without an extension
+#if !defined(__EMSCRIPTEN__)
+  const auto batchSize{static_cast<GLsizei>(end - begin)};
+  if (draw.m_indexed) {
+    abcg::glMultiDrawElements(draw.m_mode, m_counts.data(), GL_UNSIGNED_INT,
+                              m_offsets.data(), batchSize);
+  } else {
+    abcg::glMultiDrawArrays(draw.m_mode, m_firsts.data(), m_counts.data(),
+                            batchSize);
+  }
+  ++m_stats.drawCalls;
+#else
+  for (std::size_t index = 0; index < m_counts.size(); ++index) {
+    if (draw.m_indexed) {
+      abcg::glDrawElements(draw.m_mode, m_counts[index], GL_UNSIGNED_INT,
+                           m_offsets[index]);
+    } else {
+      abcg::glDrawArrays(draw.m_mode, m_firsts[index], m_counts[index]);
+    }
+    ++m_stats.drawCalls;
+  }
+#endif
+}
+
+Profiler::Stage RenderQueue::gpuStage(Layer layer) {
+  return layer == Layer::Items ? Profiler::Stage::ItemsDrawGPU
+                               : Profiler::Stage::CarDrawGPU;
+}
@@ -0,0 +1,113 @@
+#ifndef RENDERQUEUE_HPP_
+#define RENDERQUEUE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "abcg.hpp"
+#include "gputimer.hpp"
+
+// Draws of a frame, submitted by the renderers and issued together by
+// flush(). Within a layer, draws are sorted by program, VAO, texture and
+// blend state, so that each state change happens once, and runs of plain
+// draws sharing all of that state go out as one glMultiDrawArrays or
+// glMultiDrawElements. Layers keep their order, since objects drawn later
+// cover the ones drawn before
+class RenderQueue {
+ public:
+  enum class Layer : std::uint8_t { Items, CarTrail, Car };
+
+  // Uniforms and generic color of programs built from objects.vert, for
+  // objects drawn one at a time
+  struct ObjectUniforms {
+    glm::vec4 m_color{1};
+    glm::vec2 m_translation{glm::vec2(0)};
+    float m_rotation{};
+    float m_scale{1};
+  };
+
+  struct Draw {
+    Layer m_layer{};
+    GLuint m_program{};
+    GLuint m_vao{};
+    bool m_blend{};
+    // Bound to GL_TEXTURE_BUFFER on unit 0 when not zero
+    GLuint m_texture{};
+
+    GLenum m_mode{GL_TRIANGLES};
+    // Indexed draws read m_count GL_UNSIGNED_INT indices starting at byte
+    // m_indexOffset of the VAO's element buffer; others read m_count
+    // vertices starting at m_first
+    bool m_indexed{};
+    GLint m_first{};
+    GLsizei m_count{};
+    std::size_t m_indexOffset{};
+    // Instanced when greater than 1
+    GLsizei m_instances{1};
+  };
+
+  struct Stats {
+    int draws{};
+    int drawCalls{};
+    int stateChanges{};
+  };
+
+  // Clears requested before any draw collapse into one
+  void clear(GLbitfield mask, const glm::vec4 &color);
+  void submit(const Draw &draw);
+  void submit(const Draw &draw, const ObjectUniforms &uniforms);
+
+  // Issues every draw submitted since the last flush, timing each layer
+  // with timer, then leaves no program, VAO or blending bound
+  void flush(GpuTimer &timer);
+
+  // Counts of the last flush
+  [[nodiscard]] const Stats &stats() const { return m_stats; }
+
+ private:
+  struct Command {
+    Draw m_draw;
+    // Index into m_uniforms, or noUniforms
+    std::uint32_t m_uniforms{};
+  };
+  static constexpr std::uint32_t noUniforms{~std::uint32_t{}};
+
+  // Locations looked up once per program
+  struct ObjectLocations {
+    GLuint m_program{};
+    GLint m_rotation{};
+    GLint m_scale{};
+    GLint m_translation{};
+    GLint m_color{};
+  };
+
+  GLbitfield m_clearMask{};
+  glm::vec4 m_clearColor{};
+
+  std::vector<Command> m_commands;
+  std::vector<ObjectUniforms> m_uniforms;
+  std::vector<std::uint32_t> m_order;
+  std::vector<ObjectLocations> m_locations;
+
+  // Scratch for the multi-draw calls
+  std::vector<GLint> m_firsts;
+  std::vector<GLsizei> m_counts;
+  std::vector<const void *> m_offsets;
+
+  // State the GL currently has, as far as the queue knows
+  GLuint m_program{};
+  GLuint m_vao{};
+  GLuint m_texture{};
+  bool m_blend{};
+
+  Stats m_stats;
+
+  void apply(const Draw &draw);
+  void setUniforms(GLuint program, const ObjectUniforms &uniforms);
+  [[nodiscard]] std::size_t batchEnd(std::size_t begin) const;
+  void issue(std::size_t begin, std::size_t end);
+  [[nodiscard]] static Profiler::Stage gpuStage(Layer layer);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "sessions.hpp"
+
+#include <stdexcept>
+
+// Worlds are reused from one reset to the next, and only restarted
+void Sessions::reset(std::size_t count, int items, unsigned int seed) {
+  while (m_worlds.size() < count) {
+    m_worlds.push_back(std::make_unique<World>());
+  }
+  m_worlds.resize(count);
+
+  m_pool.parallelFor(count, sessionChunk, [&](auto, auto begin, auto end) {
+    for (auto index{begin}; index < end; ++index) {
+      m_worlds[index]->setMeshSeed(seed);
+      m_worlds[index]->restart(items,
+                               seed + static_cast<unsigned int>(index));
+    }
+  });
+
+  m_scores.assign(count, 0);
+  m_states.assign(count, State::Playing);
+  m_transitions.clear();
+  m_chunkTransitions.resize(ThreadPool::chunkCount(count, sessionChunk));
+}
+
+void Sessions::step(std::span<const std::uint8_t> inputs, float deltaTime) {
+  if (inputs.size() != m_worlds.size()) {
+    throw std::invalid_argument{"Sessions::step needs one input per session"};
+  }
+
+  m_pool.parallelFor(
+      m_worlds.size(), sessionChunk, [&](auto chunk, auto begin, auto end) {
+        auto &transitions{m_chunkTransitions[chunk]};
+        transitions.clear();
+        for (auto index{begin}; index < end; ++index) {
+          auto &world{*m_worlds[index]};
+          world.setInput(inputs[index]);
+          world.step(deltaTime);
+
+          const auto state{world.gameData().m_state};
+          m_scores[index] = world.objects();
+          if (state != m_states[index]) {
+            m_states[index] = state;
+            transitions.push_back({index, state, m_scores[index]});
+          }
+        }
+      });
+
+  m_transitions.clear();
+  for (const auto &transitions : m_chunkTransitions) {
+    m_transitions.insert(m_transitions.end(), transitions.begin(),
+                         transitions.end());
+  }
+}
+
+std::uint64_t Sessions::checksum() const {
+  std::uint64_t hash{14695981039346656037ULL};
+  for (const auto &world : m_worlds) {
+    hash = (hash ^ world->checksum()) * 1099511628211ULL;
+  }
+  return hash;
+}
@@ -0,0 +1,66 @@
+#ifndef SESSIONS_HPP_
+#define SESSIONS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "gamedata.hpp"
+#include "threadpool.hpp"
+#include "world.hpp"
+
+// Many independent games stepped together, without a window or GL, for
+// bots and for checking scores on a server. Session i is a World of its own
+// started from seed + i, all on the mesh pool of seed, and each step
+// spreads chunks of sessions over a
+// thread pool. Every session runs on one thread, so the results do not
+// depend on the thread count
+class Sessions {
+ public:
+  void reset(std::size_t count, int items, unsigned int seed);
+
+  void setThreads(int threads) { m_pool.resize(threads); }
+  [[nodiscard]] int threads() const { return m_pool.size(); }
+  [[nodiscard]] std::size_t size() const { return m_worlds.size(); }
+
+  // One tick of every session, session i with inputs[i], a GameData::m_input
+  // bit set. inputs must hold size() entries
+  void step(std::span<const std::uint8_t> inputs, float deltaTime);
+
+  // Items collected so far in the current round of each session
+  [[nodiscard]] const std::vector<int> &scores() const { return m_scores; }
+  [[nodiscard]] const std::vector<State> &states() const { return m_states; }
+
+  // A round that ended, with its final score, or a new one that started
+  struct Transition {
+    std::size_t session;
+    State state;
+    int score;
+  };
+  // Of the last step, in session order
+  [[nodiscard]] const std::vector<Transition> &transitions() const {
+    return m_transitions;
+  }
+
+  [[nodiscard]] const World &session(std::size_t index) const {
+    return *m_worlds[index];
+  }
+  // Of every session's World::checksum(), in session order
+  [[nodiscard]] std::uint64_t checksum() const;
+
+ private:
+  static constexpr std::size_t sessionChunk{16};
+
+  std::vector<std::unique_ptr<World>> m_worlds;
+  std::vector<int> m_scores;
+  std::vector<State> m_states;
+
+  std::vector<Transition> m_transitions;
+  std::vector<std::vector<Transition>> m_chunkTransitions;
+
+  ThreadPool m_pool;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "simulationthread.hpp"
+
+#include <chrono>
+#include <utility>
+
+void SimulationThread::start(Step step) {
+  stop();
+
+  m_step = std::move(step);
+  m_stopping = false;
+  m_busyClock = 0;
+  m_thread = std::thread{[this] { run(); }};
+}
+
+void SimulationThread::stop() {
+  if (!m_thread.joinable()) return;
+  {
+    std::lock_guard lock{m_mutex};
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+
+void SimulationThread::setPaused(bool paused) {
+  if (m_paused.exchange(paused) == paused) return;
+  // The thread may be between checking m_paused and waiting
+  { std::lock_guard lock{m_mutex}; }
+  m_wake.notify_all();
+}
+
+double SimulationThread::busySeconds(Clock::time_point now) const {
+  const auto clock{m_busyClock.load(std::memory_order_relaxed)};
+  const auto busy{clock % 2 == 0
+                      ? clock / 2
+                      : (clock - 1) / 2 + now.time_since_epoch().count()};
+  return std::chrono::duration<double>(Clock::duration{busy}).count();
+}
+
+// The mutex is held while stepping and released while sleeping
+void SimulationThread::run() {
+  Clock::rep busy{};
+  auto last{Clock::now()};
+  std::unique_lock lock{m_mutex};
+  while (true) {
+    if (m_paused) {
+      // Time spent paused is dropped
+      m_wake.wait(lock, [this] { return m_stopping || !m_paused; });
+      last = Clock::now();
+    }
+    if (m_stopping) return;
+
+    const auto start{Clock::now()};
+    m_busyClock.store((busy - start.time_since_epoch().count()) * 2 + 1,
+                      std::memory_order_relaxed);
+    const auto wait{
+        m_step(std::chrono::duration<float>(start - last).count())};
+    last = start;
+    const auto end{Clock::now()};
+    busy += (end - start).count();
+    m_busyClock.store(busy * 2, std::memory_order_relaxed);
+
+    m_wake.wait_until(
+        lock,
+        end + std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<float>(wait)),
+        [this] { return m_stopping || m_paused; });
+  }
+}
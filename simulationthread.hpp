@@ -0,0 +1,63 @@
+#ifndef SIMULATIONTHREAD_HPP_
+#define SIMULATIONTHREAD_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "profiler.hpp"
+
+// Runs the simulation on a thread of its own, so that its ticks overlap the
+// frames drawn by the render thread instead of adding to them. step runs
+// there with the wall time since its last call, and returns the seconds
+// the thread may sleep until the next tick is due. Other threads reach the
+// simulated state only through lock(), which holds the thread between two
+// steps; the state the render thread draws and the input it sends travel
+// without locks
+class SimulationThread {
+ public:
+  using Clock = Profiler::Clock;
+  using Step = std::function<float(float deltaTime)>;
+
+  SimulationThread() = default;
+  ~SimulationThread() { stop(); }
+
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  void start(Step step);
+  void stop();
+  [[nodiscard]] bool running() const { return m_thread.joinable(); }
+
+  // No time passes for the simulation while paused
+  void setPaused(bool paused);
+
+  [[nodiscard]] std::unique_lock<std::mutex> lock() {
+    return std::unique_lock{m_mutex};
+  }
+
+  // Seconds spent in step() since start(), including the current one. Any
+  // thread may call it, for instance to find how much of the simulation
+  // overlapped some other work
+  [[nodiscard]] double busySeconds(Clock::time_point now) const;
+
+ private:
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stopping{};
+  // Also read without the lock, which is only taken when it changes
+  std::atomic<bool> m_paused{};
+  Step m_step;
+
+  // Busy nanoseconds in one value, so that it reads consistently: twice the
+  // total while idle, or twice the total minus the start of the running
+  // step, plus one
+  std::atomic<Clock::rep> m_busyClock{};
+
+  void run();
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "snapshot.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "world.hpp"
+
+namespace {
+
+// Bumped whenever the layout or the meaning of a field changes
+constexpr std::string_view magic{"CARSNP02"};
+// Reads back as another value on a machine of the other byte order
+constexpr std::uint32_t byteOrder{0x01020304};
+
+constexpr std::size_t arrayCount{10};
+constexpr std::size_t arrayAlignment{64};
+// Far above what any item count asks for, and far below what would exhaust
+// memory
+constexpr std::int32_t maxCellsPerSide{4096};
+
+// Laid out without padding, so that the file holds no stray bytes
+struct Header {
+  std::array<char, 8> magic;
+  std::uint32_t byteOrder;
+  std::uint32_t meshSeed;
+  std::uint64_t items;
+  std::uint64_t checksum;
+  Philox::State worldRandom;
+  Philox::State itemsRandom;
+  std::array<std::uint64_t, arrayCount> offsets;
+
+  std::int32_t quantity;
+  std::int32_t rounds;
+  std::int32_t objects;
+  std::int32_t cellsPerSide;
+  std::uint32_t state;
+  std::uint32_t input;
+  float gameTime;
+  float restartWaitTime;
+
+  float carRotation;
+  float carScale;
+  glm::vec2 carTranslation;
+  glm::vec2 carVelocity;
+  float carPreviousRotation;
+  glm::vec2 carPreviousTranslation;
+  std::uint32_t reserved;
+};
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(sizeof(Header) == 232);
+
+std::uint64_t alignUp(std::uint64_t offset) {
+  return (offset + arrayAlignment - 1) / arrayAlignment * arrayAlignment;
+}
+
+// Whether a stored item value is one the simulation and drawing accept: the
+// grid needs finite positions, and drawing a mesh index of the pool
+bool isValid(float value) { return std::isfinite(value); }
+bool isValid(glm::vec2 value) { return isValid(value.x) && isValid(value.y); }
+bool isValid(glm::vec4 value) {
+  return isValid(value.x) && isValid(value.y) && isValid(value.z) &&
+         isValid(value.w);
+}
+bool isValid(int mesh) { return mesh >= 0 && mesh < Items::numMeshes; }
+bool isValid(std::uint8_t /*alive*/) { return true; }
+
+// The file's bytes, mapped where the platform can, read otherwise
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &path) {
+#if defined(__unix__) || defined(__APPLE__)
+    const auto file{open(path.c_str(), O_RDONLY)};
+    if (file < 0) {
+      throw std::runtime_error{fmt::format("Cannot open {}", path)};
+    }
+    struct stat status {};
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+      m_size = static_cast<std::size_t>(status.st_size);
+      m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    close(file);
+    if (m_data == MAP_FAILED) m_data = nullptr;
+    if (m_data == nullptr) m_size = 0;
+#else
+    std::ifstream stream{path, std::ios::binary | std::ios::ate};
+    if (!stream) {
+      throw std::runtime_error{fmt::format("Cannot open {}", path)};
+    }
+    m_buffer.resize(static_cast<std::size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char *>(m_buffer.data()),
+                static_cast<std::streamsize>(m_buffer.size()));
+#endif
+  }
+
+  ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_data != nullptr) munmap(m_data, m_size);
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  [[nodiscard]] std::span<const std::byte> bytes() const {
+#if defined(__unix__) || defined(__APPLE__)
+    return {static_cast<const std::byte *>(m_data), m_size};
+#else
+    return m_buffer;
+#endif
+  }
+
+ private:
+#if defined(__unix__) || defined(__APPLE__)
+  void *m_data{};
+  std::size_t m_size{};
+#else
+  std::vector<std::byte> m_buffer;
+#endif
+};
+
+}  // namespace
+
+// Every item array, in file order
+template <typename ItemsType, typename Visitor>
+void Snapshot::forEachArray(ItemsType &items, Visitor &&visit) {
+  visit(items.m_translations);
+  visit(items.m_velocities);
+  visit(items.m_rotations);
+  visit(items.m_angularVelocities);
+  visit(items.m_scales);
+  visit(items.m_colors);
+  visit(items.m_meshes);
+  visit(items.m_alive);
+  visit(items.m_previousTranslations);
+  visit(items.m_previousRotations);
+}
+
+void Snapshot::save(World &world, const std::string &path) {
+  if (world.m_itemsMotion != nullptr) {
+    world.m_itemsMotion->download(world.m_items);
+  }
+  const auto &items{world.m_items};
+  const auto &car{world.m_car};
+
+  Header header{};
+  std::copy(magic.begin(), magic.end(), header.magic.begin());
+  header.byteOrder = byteOrder;
+  header.meshSeed = world.m_meshSeed;
+  header.items = items.size();
+  header.checksum = world.checksum();
+  header.worldRandom = world.m_random.state();
+  header.itemsRandom = items.m_random.state();
+  header.quantity = world.m_quantity;
+  header.rounds = world.m_rounds;
+  header.objects = world.m_objects;
+  header.cellsPerSide = items.m_grid.cellsPerSide();
+  header.state = static_cast<std::uint32_t>(world.m_gameData.m_state);
+  header.input =
+      static_cast<std::uint32_t>(world.m_gameData.m_input.to_ulong());
+  header.gameTime = world.m_gameTime;
+  header.restartWaitTime = world.m_restartWaitTime;
+  header.carRotation = car.m_rotation;
+  header.carScale = car.m_scale;
+  header.carTranslation = car.m_translation;
+  header.carVelocity = car.m_velocity;
+  header.carPreviousRotation = car.m_previousRotation;
+  header.carPreviousTranslation = car.m_previousTranslation;
+
+  auto offset{alignUp(sizeof(Header))};
+  std::size_t array{};
+  forEachArray(items, [&](const auto &values) {
+    header.offsets.at(array++) = offset;
+    offset = alignUp(offset + values.size() * sizeof(values[0]));
+  });
+
+  std::ofstream stream{path, std::ios::binary};
+  if (!stream) {
+    throw std::runtime_error{fmt::format("Cannot write {}", path)};
+  }
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  std::uint64_t position{sizeof(header)};
+  const std::array<char, arrayAlignment> padding{};
+  array = 0;
+  forEachArray(items, [&](const auto &values) {
+    const auto start{header.offsets.at(array++)};
+    stream.write(padding.data(),
+                 static_cast<std::streamsize>(start - position));
+    const auto size{values.size() * sizeof(values[0])};
+    stream.write(reinterpret_cast<const char *>(values.data()),
+                 static_cast<std::streamsize>(size));
+    position = start + size;
+  });
+
+  if (!stream) {
+    throw std::runtime_error{fmt::format("Cannot write {}", path)};
+  }
+}
+
+std::uint64_t Snapshot::load(World &world, const std::string &path) {
+  const MappedFile file{path};
+  const auto bytes{file.bytes()};
+
+  Header header{};
+  if (bytes.size() < sizeof(header)) {
+    throw std::runtime_error{fmt::format("{} is not a snapshot", path)};
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::string_view{header.magic.data(), header.magic.size()} != magic) {
+    throw std::runtime_error{fmt::format("{} is not a snapshot", path)};
+  }
+  if (header.byteOrder != byteOrder) {
+    throw std::runtime_error{fmt::format(
+        "{} was saved on a machine of another byte order", path)};
+  }
+
+  // The whole file is checked before anything is touched: the grid size is
+  // the one the round's item count gives, every array lies inside the file,
+  // and every value is one the World can run and draw
+  const auto corrupt{[&path] {
+    return std::runtime_error{
+        fmt::format("{} is truncated or corrupt", path)};
+  }};
+  if (header.quantity < 0 || header.cellsPerSide < 1 ||
+      header.cellsPerSide > maxCellsPerSide ||
+      header.cellsPerSide !=
+          std::max(4, static_cast<int>(std::sqrt(header.quantity / 4.0))) ||
+      header.state > static_cast<std::uint32_t>(State::Win) ||
+      header.items > bytes.size()) {
+    throw corrupt();
+  }
+  for (const auto value :
+       {header.gameTime, header.restartWaitTime, header.carRotation,
+        header.carScale, header.carPreviousRotation}) {
+    if (!isValid(value)) throw corrupt();
+  }
+  for (const auto value : {header.carTranslation, header.carVelocity,
+                           header.carPreviousTranslation}) {
+    if (!isValid(value)) throw corrupt();
+  }
+
+  const auto count{static_cast<std::size_t>(header.items)};
+  auto &items{world.m_items};
+  std::size_t array{};
+  forEachArray(items, [&](const auto &values) {
+    using Value = std::remove_cvref_t<decltype(values[0])>;
+    const auto offset{header.offsets.at(array++)};
+    if (offset % arrayAlignment != 0 || offset > bytes.size() ||
+        count * sizeof(Value) > bytes.size() - offset) {
+      throw corrupt();
+    }
+    const std::span stored{
+        reinterpret_cast<const Value *>(bytes.data() + offset), count};
+    if (!std::all_of(stored.begin(), stored.end(),
+                     [](const auto &value) { return isValid(value); })) {
+      throw corrupt();
+    }
+  });
+
+  items.reserve(count);
+  array = 0;
+  forEachArray(items, [&](auto &values) {
+    using Value = std::remove_reference_t<decltype(values[0])>;
+    const auto *first{reinterpret_cast<const Value *>(
+        bytes.data() + header.offsets.at(array++))};
+    values.assign(first, first + count);
+  });
+  items.m_highWater = std::max(items.m_highWater, count);
+  items.m_random.setState(header.itemsRandom);
+
+  // Cell order within the grid does not matter to the simulation
+  items.m_grid.reset(header.cellsPerSide);
+  for (auto index : iter::range(count)) {
+    items.m_grid.insert(index, items.m_translations[index]);
+  }
+
+  auto &car{world.m_car};
+  car.m_rotation = header.carRotation;
+  car.m_scale = header.carScale;
+  car.m_translation = header.carTranslation;
+  car.m_velocity = header.carVelocity;
+  car.m_previousRotation = header.carPreviousRotation;
+  car.m_previousTranslation = header.carPreviousTranslation;
+
+  world.m_random.setState(header.worldRandom);
+  world.m_quantity = header.quantity;
+  world.m_meshSeed = header.meshSeed;
+  world.m_rounds = header.rounds;
+  world.m_objects = header.objects;
+  world.m_gameData.m_state = static_cast<State>(header.state);
+  world.m_gameData.m_input = header.input;
+  world.m_gameTime = header.gameTime;
+  world.m_restartWaitTime = header.restartWaitTime;
+  world.m_hits.clear();
+
+  if (world.m_itemsMotion != nullptr) world.m_itemsMotion->upload(items);
+  return header.checksum;
+}
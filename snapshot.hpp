@@ -0,0 +1,35 @@
+#ifndef SNAPSHOT_HPP_
+#define SNAPSHOT_HPP_
+
+#include <cstdint>
+#include <string>
+
+class World;
+
+// The whole state of a World in one file, to resume a game or to start a
+// benchmark from a stored state: the car, every item with its state at the
+// start of the last tick, the round timers and counters, and both random
+// generators. A loaded World steps on exactly as the saved one would, and
+// its meshSeed() rebuilds the mesh pool the items were drawn with
+//
+// On disk: a fixed header ("CARSNP02", a byte order marker, the mesh seed,
+// counts, car, timers, generator states, World::checksum() and the offset
+// of every item array), then the item arrays as Items stores them, each
+// aligned to 64 bytes, all in the byte order of the machine that saved
+// them. Loading rejects another byte order, maps the file and copies each
+// array in one go
+class Snapshot {
+ public:
+  // Both throw std::runtime_error if the file cannot be written or read.
+  // Saving first brings the items back from any ItemsMotion, and loading
+  // hands them over to it
+  static void save(World &world, const std::string &path);
+  // Returns the checksum the World had when saved
+  static std::uint64_t load(World &world, const std::string &path);
+
+ private:
+  template <typename ItemsType, typename Visitor>
+  static void forEachArray(ItemsType &items, Visitor &&visit);
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "softwarerenderer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr SoftwareRenderer::Pixel opaque{0xFF000000U};
+
+}  // namespace
+
+void SoftwareRenderer::initialize(int width, int height, unsigned int seed) {
+  m_width = std::max(1, width);
+  m_height = std::max(1, height);
+  m_meshes.create(seed);
+}
+
+void SoftwareRenderer::setClearColor(glm::vec4 color) {
+  m_clearColor = toPixel(color) & ~opaque;
+}
+
+SoftwareRenderer::Pixel SoftwareRenderer::toPixel(glm::vec4 color) {
+  const auto channel{[](float value, int shift) {
+    const auto byte{std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f)};
+    return static_cast<Pixel>(byte) << shift;
+  }};
+  return channel(color.r, 0) | channel(color.g, 8) | channel(color.b, 16) |
+         channel(color.a, 24);
+}
+
+// The [-1, 1] view spans the image, y up
+glm::vec2 SoftwareRenderer::toScreen(glm::vec2 position) const {
+  return {(position.x + 1.0f) * 0.5f * static_cast<float>(m_width),
+          (1.0f - position.y) * 0.5f * static_cast<float>(m_height)};
+}
+
+void SoftwareRenderer::render(const World &world, std::span<Pixel> frame,
+                              std::vector<std::size_t> &order,
+                              float interpolation) const {
+  std::fill(frame.begin(), frame.end(), m_clearColor);
+
+  // The window draws items grouped by mesh, in index order within a mesh,
+  // and so decides which of two overlapping items is on top
+  const auto &items{world.items()};
+  std::array<std::size_t, Items::numMeshes + 1> groupStart{};
+  for (auto index : iter::range(items.size())) {
+    ++groupStart.at(items.m_meshes[index] + 1U);
+  }
+  for (auto mesh : iter::range(1, Items::numMeshes + 1)) {
+    groupStart.at(mesh) += groupStart.at(mesh - 1);
+  }
+  order.resize(items.size());
+  for (auto index : iter::range(items.size())) {
+    order[groupStart.at(items.m_meshes[index])++] = index;
+  }
+
+  // Same as objects.vert: rotated, scaled, then moved, for each copy
+  std::array<glm::vec2, Items::maxSides + 2> fan{};
+  for (auto index : order) {
+    const auto mesh{items.m_meshes[index]};
+    const auto first{m_meshes.m_first.at(mesh)};
+    const auto count{m_meshes.m_count.at(mesh)};
+    const auto translation{items.renderTranslation(index, interpolation)};
+    const auto rotation{items.renderRotation(index, interpolation)};
+    const auto scale{items.m_scales[index]};
+    const auto color{toPixel(items.m_colors[index]) | opaque};
+
+    const auto sinAngle{std::sin(rotation)};
+    const auto cosAngle{std::cos(rotation)};
+    for (auto vertex : iter::range(count)) {
+      const auto position{m_meshes.m_positions.at(
+          static_cast<std::size_t>(first + vertex))};
+      fan.at(vertex) = glm::vec2{position.x * cosAngle - position.y * sinAngle,
+                                 position.x * sinAngle + position.y * cosAngle} *
+                       scale;
+    }
+
+    for (auto i : {-2, 0, 2}) {
+      for (auto j : {-2, 0, 2}) {
+        const auto center{translation + glm::vec2(j, i)};
+        if (std::abs(center.x) >= 1.0f + scale ||
+            std::abs(center.y) >= 1.0f + scale) {
+          continue;
+        }
+        const auto hub{toScreen(center + fan.at(0))};
+        auto previous{toScreen(center + fan.at(1))};
+        for (auto vertex : iter::range(2, count)) {
+          const auto next{toScreen(center + fan.at(vertex))};
+          fillTriangle(frame, hub, previous, next, color);
+          previous = next;
+        }
+      }
+    }
+  }
+
+  if (world.gameData().m_state == State::Playing) {
+    const auto &car{world.car()};
+    const auto &mesh{Car::mesh()};
+    const auto translation{car.renderTranslation(interpolation)};
+    const auto rotation{car.renderRotation(interpolation)};
+    const auto sinAngle{std::sin(rotation)};
+    const auto cosAngle{std::cos(rotation)};
+    const auto transform{[&](unsigned int vertex) {
+      const auto position{mesh.m_positions.at(vertex)};
+      return toScreen(
+          glm::vec2{position.x * cosAngle - position.y * sinAngle,
+                    position.x * sinAngle + position.y * cosAngle} *
+              car.m_scale +
+          translation);
+    }};
+
+    // Each triangle has a single color
+    for (std::size_t index = 0; index < mesh.m_indices.size(); index += 3) {
+      const auto a{mesh.m_indices.at(index)};
+      fillTriangle(frame, transform(a), transform(mesh.m_indices.at(index + 1)),
+                   transform(mesh.m_indices.at(index + 2)),
+                   toPixel(mesh.m_colors.at(a)) | opaque);
+    }
+  }
+
+  for (auto &pixel : frame) {
+    pixel |= opaque;
+  }
+}
+
+void SoftwareRenderer::render(const Sessions &sessions,
+                              std::span<Pixel> frames,
+                              ThreadPool &pool) {
+  const auto size{frameSize()};
+  m_chunkOrders.resize(ThreadPool::chunkCount(sessions.size(), sessionChunk));
+  pool.parallelFor(
+      sessions.size(), sessionChunk, [&](auto chunk, auto begin, auto end) {
+        for (auto index{begin}; index < end; ++index) {
+          render(sessions.session(index), frames.subspan(index * size, size),
+                 m_chunkOrders[chunk]);
+        }
+      });
+}
+
+// Scanline fill of the pixels whose centers are inside the triangle or on
+// its edges. Each row is one span, found from the three edge functions, and
+// filled by a branch-free loop that the compiler vectorizes. Pixels already
+// drawn on keep their color
+void SoftwareRenderer::fillTriangle(std::span<Pixel> frame, glm::vec2 a,
+                                    glm::vec2 b, glm::vec2 c,
+                                    Pixel color) const {
+  const auto area{(b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x)};
+  if (area == 0.0f) return;
+  if (area < 0.0f) std::swap(b, c);
+
+  const auto left{std::max(
+      0, static_cast<int>(std::ceil(std::min({a.x, b.x, c.x}) - 0.5f)))};
+  const auto right{std::min(
+      m_width - 1,
+      static_cast<int>(std::floor(std::max({a.x, b.x, c.x}) - 0.5f)))};
+  const auto top{std::max(
+      0, static_cast<int>(std::ceil(std::min({a.y, b.y, c.y}) - 0.5f)))};
+  const auto bottom{std::min(
+      m_height - 1,
+      static_cast<int>(std::floor(std::max({a.y, b.y, c.y}) - 0.5f)))};
+  if (left > right || top > bottom) return;
+
+  // Inside where (q - p) x (point - p) >= 0 for every edge p -> q
+  const std::array<std::pair<glm::vec2, glm::vec2>, 3> edges{
+      {{a, b}, {b, c}, {c, a}}};
+  for (auto y : iter::range(top, bottom + 1)) {
+    const auto centerY{static_cast<float>(y) + 0.5f};
+    auto from{static_cast<float>(left) + 0.5f};
+    auto to{static_cast<float>(right) + 0.5f};
+    for (const auto &[p, q] : edges) {
+      // slope * x + offset >= 0
+      const auto slope{p.y - q.y};
+      const auto offset{(q.x - p.x) * (centerY - p.y) - slope * p.x};
+      if (slope > 0.0f) {
+        from = std::max(from, -offset / slope);
+      } else if (slope < 0.0f) {
+        to = std::min(to, -offset / slope);
+      } else if (offset < 0.0f) {
+        to = -1.0f;
+      }
+    }
+
+    const auto first{std::max(left, static_cast<int>(std::ceil(from - 0.5f)))};
+    const auto last{std::min(right, static_cast<int>(std::floor(to - 0.5f)))};
+    auto *row{frame.data() + static_cast<std::size_t>(y) *
+                                 static_cast<std::size_t>(m_width)};
+    for (auto x{first}; x <= last; ++x) {
+      row[x] = (row[x] & opaque) != 0 ? row[x] : color;
+    }
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef SOFTWARERENDERER_HPP_
+#define SOFTWARERENDERER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "itemmeshes.hpp"
+#include "sessions.hpp"
+#include "threadpool.hpp"
+#include "world.hpp"
+
+// Renders a World on the CPU into small RGBA images, without a GPU or
+// display: observations for bots and golden images for regression checks.
+// It draws what the window draws by default, with the transform of
+// objects.vert: every item as its fan at the nine copies of the wrapped
+// world that reach the view, then the car while a round is on. In the
+// window all of it lies at depth 0 under the default depth test, so the
+// first object drawn on a pixel keeps it, and the same holds here.
+// Differences from the GPU are limited to pixels on the edges of triangles
+class SoftwareRenderer {
+ public:
+  // RGBA8 in one value, red in the low byte. Rows go from the top of the
+  // view down
+  using Pixel = std::uint32_t;
+
+  // seed picks the item shapes, as the window's does
+  void initialize(int width, int height, unsigned int seed);
+  void setClearColor(glm::vec4 color);
+
+  [[nodiscard]] int width() const { return m_width; }
+  [[nodiscard]] int height() const { return m_height; }
+  [[nodiscard]] std::size_t frameSize() const {
+    return static_cast<std::size_t>(m_width) *
+           static_cast<std::size_t>(m_height);
+  }
+
+  // frame must hold frameSize() pixels. order is scratch space for the
+  // draw order, kept by the caller so that frames stop allocating once it
+  // has grown. Several threads may render at once, each with its own order
+  void render(const World &world, std::span<Pixel> frame,
+              std::vector<std::size_t> &order,
+              float interpolation = 1.0f) const;
+  // Session i of sessions into the i-th frameSize() pixels of frames, on
+  // the threads of pool
+  void render(const Sessions &sessions, std::span<Pixel> frames,
+              ThreadPool &pool);
+
+  [[nodiscard]] static Pixel toPixel(glm::vec4 color);
+
+ private:
+  ItemMeshes m_meshes;
+  int m_width{};
+  int m_height{};
+  // Alpha 0 marks the pixels nothing was drawn on yet
+  Pixel m_clearColor{toPixel({0.906f, 0.910f, 0.918f, 0.0f})};
+
+  // Draw order scratch of each chunk of sessions
+  static constexpr std::size_t sessionChunk{4};
+  std::vector<std::vector<std::size_t>> m_chunkOrders;
+
+  [[nodiscard]] glm::vec2 toScreen(glm::vec2 position) const;
+  void fillTriangle(std::span<Pixel> frame, glm::vec2 a, glm::vec2 b,
+                    glm::vec2 c, Pixel color) const;
+};
+
+#endif
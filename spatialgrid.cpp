@@ -0,0 +1,209 @@
+#include "spatialgrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <limits>
+
+void SpatialGrid::reset(int cellsPerSide) {
+  m_cellsPerSide = std::max(cellsPerSide, 1);
+  m_cellSize = 2.0f / static_cast<float>(m_cellsPerSide);
+
+  const auto cells{static_cast<std::size_t>(m_cellsPerSide * m_cellsPerSide)};
+  if (m_cells.size() == cells) {
+    for (auto &members : m_cells) members.clear();
+  } else {
+    m_cells.assign(cells, {});
+    reserveCells();
+    ++m_allocations;
+  }
+  m_itemCell.clear();
+  m_itemSlot.clear();
+}
+
+void SpatialGrid::reserve(std::size_t items) {
+  if (items <= m_itemCell.capacity()) return;
+  m_itemCell.reserve(items);
+  m_itemSlot.reserve(items);
+  reserveCells();
+
+  // Every item may change cells in the same update
+  m_chunkMoves.resize(ThreadPool::chunkCount(items, itemChunk));
+  for (auto &moves : m_chunkMoves) {
+    moves.reserve(std::min(items, itemChunk));
+  }
+  m_moves.reserve(items);
+  ++m_allocations;
+}
+
+// Room for well above the mean occupancy, so that cells rarely grow as
+// items move between them
+void SpatialGrid::reserveCells() {
+  if (m_cells.empty()) return;
+
+  const auto mean{m_itemCell.capacity() / m_cells.size()};
+  for (auto &members : m_cells) {
+    members.reserve(mean * 3 + 8);
+  }
+}
+
+void SpatialGrid::insert(std::size_t item, glm::vec2 position) {
+  if (item >= m_itemCell.size()) {
+    if (item >= m_itemCell.capacity()) ++m_allocations;
+    m_itemCell.resize(item + 1, -1);
+    m_itemSlot.resize(item + 1);
+  }
+  if (link(item, cellOf(position))) ++m_allocations;
+}
+
+void SpatialGrid::move(std::size_t item, glm::vec2 position) {
+  const auto cell{cellOf(position)};
+  if (cell == m_itemCell[item]) return;
+
+  unlink(item);
+  if (link(item, cell)) ++m_allocations;
+}
+
+void SpatialGrid::update(const std::vector<glm::vec2> &positions,
+                         ThreadPool &pool) {
+  const auto count{m_itemCell.size()};
+
+  // Never shrinks, so that the reserved lists survive a drop in item count
+  const auto chunks{ThreadPool::chunkCount(count, itemChunk)};
+  if (m_chunkMoves.size() < chunks) m_chunkMoves.resize(chunks);
+  pool.parallelFor(count, itemChunk, [&](auto chunk, auto begin, auto end) {
+    auto &moves{m_chunkMoves[chunk]};
+    moves.clear();
+    for (auto item{begin}; item < end; ++item) {
+      const auto cell{cellOf(positions[item])};
+      if (cell != m_itemCell[item]) {
+        moves.push_back({item, m_itemCell[item], cell});
+      }
+    }
+  });
+
+  m_moves.clear();
+  for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+    const auto &moves{m_chunkMoves[chunk]};
+    m_moves.insert(m_moves.end(), moves.begin(), moves.end());
+  }
+  if (m_moves.empty()) return;
+
+  // Unlinking only touches the old cell and the items in it, and linking
+  // only the new cell, so chunks of cells can run in parallel
+  const auto cells{m_cells.size()};
+  const auto cellChunk{
+      (cells + static_cast<std::size_t>(pool.size()) - 1) /
+      static_cast<std::size_t>(pool.size())};
+  const auto owns{[](std::size_t begin, std::size_t end, int cell) {
+    const auto index{static_cast<std::size_t>(cell)};
+    return index >= begin && index < end;
+  }};
+
+  pool.parallelFor(cells, cellChunk,
+                   [&](auto /*chunk*/, auto begin, auto end) {
+                     for (const auto &move : m_moves) {
+                       if (owns(begin, end, move.from)) unlink(move.item);
+                     }
+                   });
+  m_chunkAllocations.assign(ThreadPool::chunkCount(cells, cellChunk), 0);
+  pool.parallelFor(cells, cellChunk, [&](auto chunk, auto begin, auto end) {
+    for (const auto &move : m_moves) {
+      if (owns(begin, end, move.to) && link(move.item, move.to)) {
+        ++m_chunkAllocations[chunk];
+      }
+    }
+  });
+  for (const auto allocations : m_chunkAllocations) {
+    m_allocations += allocations;
+  }
+}
+
+void SpatialGrid::cellsNear(glm::vec2 center, float radius,
+                            std::vector<int> &cells) const {
+  cells.clear();
+  forEachCellNear(center, radius, [&](int cell) { cells.push_back(cell); });
+}
+
+// Mirrors Items' swap-and-pop: the last item takes the index of the removed
+void SpatialGrid::remove(std::size_t item) {
+  unlink(item);
+
+  const auto last{m_itemCell.size() - 1};
+  if (item != last) {
+    const auto cell{m_itemCell[last]};
+    const auto slot{m_itemSlot[last]};
+    m_cells[cell][slot] = item;
+    m_itemCell[item] = cell;
+    m_itemSlot[item] = slot;
+  }
+
+  m_itemCell.pop_back();
+  m_itemSlot.pop_back();
+}
+
+glm::vec2 SpatialGrid::wrappedDelta(glm::vec2 from, glm::vec2 to) {
+  auto delta{to - from};
+  delta.x -= 2.0f * std::round(delta.x * 0.5f);
+  delta.y -= 2.0f * std::round(delta.y * 0.5f);
+  return delta;
+}
+
+float SpatialGrid::wrappedDistance(glm::vec2 a, glm::vec2 b) {
+  return glm::length(wrappedDelta(a, b));
+}
+
+// Pieces are at most one unit long, half the world, so the image of point
+// nearest to the middle of a piece is the only one that can come within
+// half a unit of it
+float SpatialGrid::wrappedSegmentDistance(glm::vec2 point, glm::vec2 start,
+                                          glm::vec2 motion) {
+  const auto pieces{std::max(1.0f, std::ceil(glm::length(motion)))};
+  const auto step{motion / pieces};
+  const auto stepLength2{glm::dot(step, step)};
+
+  auto distance{std::numeric_limits<float>::max()};
+  for (float piece = 0.0f; piece < pieces; ++piece) {
+    const auto offset{wrappedDelta(start + step * (piece + 0.5f), point)};
+    const auto along{stepLength2 > 0.0f
+                         ? std::clamp(glm::dot(offset, step) / stepLength2,
+                                      -0.5f, 0.5f)
+                         : 0.0f};
+    distance = std::min(distance, glm::length(offset - step * along));
+  }
+  return distance;
+}
+
+int SpatialGrid::wrap(int coordinate) const {
+  const auto wrapped{coordinate % m_cellsPerSide};
+  return wrapped < 0 ? wrapped + m_cellsPerSide : wrapped;
+}
+
+int SpatialGrid::coordinate(float position) const {
+  return static_cast<int>(std::floor((position + 1.0f) / m_cellSize));
+}
+
+int SpatialGrid::cellOf(glm::vec2 position) const {
+  return wrap(coordinate(position.y)) * m_cellsPerSide +
+         wrap(coordinate(position.x));
+}
+
+void SpatialGrid::unlink(std::size_t item) {
+  auto &cell{m_cells[static_cast<std::size_t>(m_itemCell[item])]};
+  const auto slot{m_itemSlot[item]};
+
+  cell[slot] = cell.back();
+  m_itemSlot[cell[slot]] = slot;
+  cell.pop_back();
+  m_itemCell[item] = -1;
+}
+
+// Returns whether the cell list had to grow
+bool SpatialGrid::link(std::size_t item, int cell) {
+  m_itemCell[item] = cell;
+  auto &members{m_cells[static_cast<std::size_t>(cell)]};
+  const auto grows{members.size() == members.capacity()};
+  m_itemSlot[item] = members.size();
+  members.push_back(item);
+  return grows;
+}
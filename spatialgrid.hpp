@@ -0,0 +1,125 @@
+#ifndef SPATIALGRID_HPP_
+#define SPATIALGRID_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "threadpool.hpp"
+
+// Uniform grid over the toroidal [-1, 1) x [-1, 1) world, indexed by item.
+// Item indices follow the swap-and-pop removal used by Items
+class SpatialGrid {
+ public:
+  // Keeps the cell lists of the previous round when the cell count is the
+  // same, so that a restart does not allocate
+  void reset(int cellsPerSide);
+  void reserve(std::size_t items);
+
+  void insert(std::size_t item, glm::vec2 position);
+  void move(std::size_t item, glm::vec2 position);
+  void remove(std::size_t item);
+
+  // Re-links every item whose cell changed. Each pool chunk owns a range of
+  // cells, and items are re-linked in index order, so the result is the same
+  // for any number of threads
+  void update(const std::vector<glm::vec2> &positions, ThreadPool &pool);
+
+  // Cells that overlap the circle, each listed once
+  void cellsNear(glm::vec2 center, float radius, std::vector<int> &cells) const;
+  [[nodiscard]] const std::vector<std::size_t> &cell(int index) const {
+    return m_cells[static_cast<std::size_t>(index)];
+  }
+
+  // Calls visit(item) for every item in the cells that overlap the circle
+  template <typename Visitor>
+  void forEachNear(glm::vec2 center, float radius, Visitor &&visit) const;
+
+  // Calls visit(a, b), a < b, for every pair of items in nearby cells
+  template <typename Visitor>
+  void forEachPair(const std::vector<glm::vec2> &positions, float distance,
+                   Visitor &&visit) const;
+
+  [[nodiscard]] int cellsPerSide() const { return m_cellsPerSide; }
+
+  // Number of times a cell list or the per-item arrays had to grow
+  [[nodiscard]] int allocations() const { return m_allocations; }
+
+  static glm::vec2 wrappedDelta(glm::vec2 from, glm::vec2 to);
+  static float wrappedDistance(glm::vec2 a, glm::vec2 b);
+  // Wrapped distance from point to the segment from start to start +
+  // motion, exact below half a unit. The motion may be longer than the world
+  static float wrappedSegmentDistance(glm::vec2 point, glm::vec2 start,
+                                      glm::vec2 motion);
+
+ private:
+  int m_cellsPerSide{1};
+  float m_cellSize{2.0f};
+
+  std::vector<std::vector<std::size_t>> m_cells;
+  std::vector<int> m_itemCell;
+  std::vector<std::size_t> m_itemSlot;
+
+  struct Move {
+    std::size_t item;
+    int from;
+    int to;
+  };
+  static constexpr std::size_t itemChunk{8192};
+  std::vector<std::vector<Move>> m_chunkMoves;
+  std::vector<Move> m_moves;
+  std::vector<int> m_chunkAllocations;
+
+  int m_allocations{};
+
+  [[nodiscard]] int wrap(int coordinate) const;
+  [[nodiscard]] int coordinate(float position) const;
+  [[nodiscard]] int cellOf(glm::vec2 position) const;
+  void reserveCells();
+  void unlink(std::size_t item);
+  [[nodiscard]] bool link(std::size_t item, int cell);
+
+  template <typename Visitor>
+  void forEachCellNear(glm::vec2 center, float radius, Visitor &&visit) const;
+};
+
+template <typename Visitor>
+void SpatialGrid::forEachCellNear(glm::vec2 center, float radius,
+                                  Visitor &&visit) const {
+  const auto firstX{coordinate(center.x - radius)};
+  const auto firstY{coordinate(center.y - radius)};
+  auto spanX{coordinate(center.x + radius) - firstX + 1};
+  auto spanY{coordinate(center.y + radius) - firstY + 1};
+  if (spanX > m_cellsPerSide) spanX = m_cellsPerSide;
+  if (spanY > m_cellsPerSide) spanY = m_cellsPerSide;
+
+  for (int y = 0; y < spanY; ++y) {
+    const auto row{wrap(firstY + y) * m_cellsPerSide};
+    for (int x = 0; x < spanX; ++x) {
+      visit(row + wrap(firstX + x));
+    }
+  }
+}
+
+template <typename Visitor>
+void SpatialGrid::forEachNear(glm::vec2 center, float radius,
+                              Visitor &&visit) const {
+  forEachCellNear(center, radius, [&](int index) {
+    for (const auto item : cell(index)) {
+      visit(item);
+    }
+  });
+}
+
+template <typename Visitor>
+void SpatialGrid::forEachPair(const std::vector<glm::vec2> &positions,
+                              float distance, Visitor &&visit) const {
+  for (std::size_t a = 0; a < m_itemCell.size(); ++a) {
+    forEachNear(positions[a], distance, [&](std::size_t b) {
+      if (a < b) visit(a, b);
+    });
+  }
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SPSCQUEUE_HPP_
+#define SPSCQUEUE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded queue from one producer thread to one consumer thread. Every call
+// finishes in a fixed number of steps, whatever the other thread does: a
+// push to a full queue fails instead of waiting. Capacity must be a power
+// of 2
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0);
+
+ public:
+  // Producer. Returns false, dropping value, when the queue is full
+  bool push(const T &value) {
+    const auto tail{m_tail.load(std::memory_order_relaxed)};
+    if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    m_slots.at(tail & (Capacity - 1)) = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer. The oldest value, or null when the queue is empty. It stays
+  // valid until pop()
+  [[nodiscard]] const T *front() const {
+    const auto head{m_head.load(std::memory_order_relaxed)};
+    if (head == m_tail.load(std::memory_order_acquire)) return nullptr;
+    return &m_slots.at(head & (Capacity - 1));
+  }
+  // Only after front() returned a value
+  void pop() {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+ private:
+  std::array<T, Capacity> m_slots{};
+  // Positions only grow, and the two live on different cache lines
+  alignas(64) std::atomic<std::size_t> m_head{};
+  alignas(64) std::atomic<std::size_t> m_tail{};
+};
+
+#endif
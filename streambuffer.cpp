@@ -0,0 +1,157 @@
+#include "streambuffer.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+void StreamBuffer::initializeGL(std::size_t frameSize, bool allowPersistent) {
+  terminateGL();
+
+  m_persistent = allowPersistent && supportsPersistentMapping();
+  create(frameSize);
+}
+
+void StreamBuffer::terminateGL() {
+  for (auto &fence : m_fences) {
+    if (fence != nullptr) abcg::glDeleteSync(fence);
+    fence = nullptr;
+  }
+  // Deleting the buffer also unmaps it
+  abcg::glDeleteBuffers(1, &m_buffer);
+  m_buffer = 0;
+  m_mapped = nullptr;
+  m_frameStarted = false;
+  m_pendingSize = 0;
+}
+
+void StreamBuffer::commit() {
+  if (m_pendingSize == 0) return;
+
+  // Persistent mappings are coherent, so only staged data needs uploading
+  if (!m_persistent) {
+    abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    abcg::glBufferSubData(GL_COPY_WRITE_BUFFER,
+                          static_cast<GLintptr>(m_pendingOffset),
+                          static_cast<GLsizeiptr>(m_pendingSize),
+                          m_staging.data());
+    abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+  m_pendingSize = 0;
+}
+
+void StreamBuffer::endFrame() {
+  commit();
+  if (!m_frameStarted) return;
+
+#if !defined(__EMSCRIPTEN__)
+  if (m_persistent) {
+    m_fences.at(m_region) =
+        abcg::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_region = (m_region + 1) % regions;
+  }
+#endif
+  m_frameStarted = false;
+}
+
+void *StreamBuffer::allocateBytes(std::size_t size, std::size_t &offset) {
+  commit();
+  if (!m_frameStarted) beginFrame();
+
+  auto start{(m_used + alignment - 1) / alignment * alignment};
+  if (start + size > m_frameSize) {
+    // Draws already issued keep the old buffer alive until they are done
+    terminateGL();
+    create(std::max(m_frameSize * 2, start + size));
+    beginFrame();
+    start = 0;
+  }
+  m_used = start + size;
+
+  if (m_persistent) {
+    offset = m_region * m_frameSize + start;
+    return m_mapped + offset;
+  }
+
+  offset = start;
+  m_pendingOffset = start;
+  m_pendingSize = size;
+  if (m_staging.size() < size) m_staging.resize(size);
+  return m_staging.data();
+}
+
+// Persistent: waits, normally not at all, until the GPU is done with the
+// region written three frames ago. Otherwise: orphans the buffer, so that
+// the driver hands out fresh storage instead of waiting
+void StreamBuffer::beginFrame() {
+  if (m_persistent) {
+    waitForRegion(m_region);
+  } else {
+    abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    abcg::glBufferData(GL_COPY_WRITE_BUFFER,
+                       static_cast<GLsizeiptr>(m_frameSize), nullptr,
+                       GL_STREAM_DRAW);
+    abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+  m_used = 0;
+  m_frameStarted = true;
+}
+
+void StreamBuffer::create(std::size_t frameSize) {
+  m_frameSize = (frameSize + alignment - 1) / alignment * alignment;
+  m_region = 0;
+
+  abcg::glGenBuffers(1, &m_buffer);
+  abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+#if !defined(__EMSCRIPTEN__) && defined(GL_MAP_PERSISTENT_BIT)
+  if (m_persistent) {
+    const auto size{static_cast<GLsizeiptr>(regions * m_frameSize)};
+    const GLbitfield flags{GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                           GL_MAP_COHERENT_BIT};
+    abcg::glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+    m_mapped = static_cast<std::byte *>(
+        abcg::glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+  }
+#endif
+  if (!m_persistent) {
+    abcg::glBufferData(GL_COPY_WRITE_BUFFER,
+                       static_cast<GLsizeiptr>(m_frameSize), nullptr,
+                       GL_STREAM_DRAW);
+  }
+  abcg::glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::waitForRegion(std::size_t region) {
+#if !defined(__EMSCRIPTEN__)
+  auto &fence{m_fences.at(region)};
+  if (fence == nullptr) return;
+
+  const GLuint64 timeout{1'000'000'000};
+  while (abcg::glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout) ==
+         GL_TIMEOUT_EXPIRED) {
+  }
+  abcg::glDeleteSync(fence);
+  fence = nullptr;
+#else
+  (void)region;
+#endif
+}
+
+bool StreamBuffer::supportsPersistentMapping() {
+#if !defined(__EMSCRIPTEN__) && defined(GL_MAP_PERSISTENT_BIT)
+  GLint major{};
+  GLint minor{};
+  abcg::glGetIntegerv(GL_MAJOR_VERSION, &major);
+  abcg::glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major > 4 || (major == 4 && minor >= 4)) return true;
+
+  GLint extensions{};
+  abcg::glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+  for (GLint index = 0; index < extensions; ++index) {
+    const auto *name{reinterpret_cast<const char *>(
+        abcg::glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(index)))};
+    if (name != nullptr && std::string_view{name} == "GL_ARB_buffer_storage") {
+      return true;
+    }
+  }
+#endif
+  return false;
+}
@@ -0,0 +1,67 @@
+#ifndef STREAMBUFFER_HPP_
+#define STREAMBUFFER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "abcg.hpp"
+
+// Ring buffer for data written by the CPU every frame and read by the draws
+// of that frame. Where the context has ARB_buffer_storage (GL 4.4), the
+// buffer is mapped once, persistently, and split into three regions, one
+// per frame in flight, each guarded by a fence. Elsewhere (GL 4.1, WebGL)
+// the buffer is orphaned at the start of every frame and data is uploaded
+// with glBufferSubData. Neither waits for the GPU in the steady state
+class StreamBuffer {
+ public:
+  // frameSize is the initial room per frame, and grows when needed.
+  // Persistent mapping is used if allowed and supported
+  void initializeGL(std::size_t frameSize, bool allowPersistent = true);
+  void terminateGL();
+
+  // Room for count values of T in this frame's region, and the byte offset
+  // of that room in buffer(). Write to it, then call commit() and point the
+  // VAOs that read it at buffer() before the next allocation, which may
+  // replace the buffer. The VAOs keep the old one alive for their draws
+  template <typename T>
+  [[nodiscard]] T *allocate(std::size_t count, std::size_t &offset) {
+    return static_cast<T *>(allocateBytes(count * sizeof(T), offset));
+  }
+  void commit();
+
+  // Call once all the draws of the frame are issued
+  void endFrame();
+
+  [[nodiscard]] GLuint buffer() const { return m_buffer; }
+  [[nodiscard]] bool persistent() const { return m_persistent; }
+  [[nodiscard]] std::size_t frameSize() const { return m_frameSize; }
+
+ private:
+  static constexpr std::size_t regions{3};
+  static constexpr std::size_t alignment{16};
+
+  GLuint m_buffer{};
+  bool m_persistent{};
+  std::size_t m_frameSize{};
+
+  // Persistent mapping: the whole buffer, and a fence per region
+  std::byte *m_mapped{};
+  std::array<GLsync, regions> m_fences{};
+  std::size_t m_region{};
+
+  // Bytes used in the current frame, and the allocation not yet committed
+  std::size_t m_used{};
+  bool m_frameStarted{};
+  std::size_t m_pendingOffset{};
+  std::size_t m_pendingSize{};
+  std::vector<std::byte> m_staging;
+
+  void *allocateBytes(std::size_t size, std::size_t &offset);
+  void beginFrame();
+  void create(std::size_t frameSize);
+  void waitForRegion(std::size_t region);
+  [[nodiscard]] static bool supportsPersistentMapping();
+};
+
+#endif
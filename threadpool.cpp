@@ -0,0 +1,79 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+void ThreadPool::resize(int threads) {
+  stop();
+
+  m_stopping = false;
+  for (int index = 1; index < std::max(threads, 1); ++index) {
+    m_workers.emplace_back(
+        [this, generation = m_generation] { workerLoop(generation); });
+  }
+}
+
+void ThreadPool::run(std::size_t chunks, void (*invoke)(void *, std::size_t),
+                     void *context) {
+  if (m_workers.empty() || chunks == 1) {
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+      invoke(context, chunk);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard lock{m_mutex};
+    m_invoke = invoke;
+    m_context = context;
+    m_chunks = chunks;
+    m_nextChunk = 0;
+    m_busyWorkers = m_workers.size();
+    ++m_generation;
+  }
+  m_wake.notify_all();
+
+  work();
+
+  std::unique_lock lock{m_mutex};
+  m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+}
+
+void ThreadPool::work() {
+  for (auto chunk{m_nextChunk++}; chunk < m_chunks; chunk = m_nextChunk++) {
+    m_invoke(m_context, chunk);
+  }
+}
+
+void ThreadPool::workerLoop(std::size_t generation) {
+  while (true) {
+    {
+      std::unique_lock lock{m_mutex};
+      m_wake.wait(lock, [&] {
+        return m_stopping || m_generation != generation;
+      });
+      if (m_stopping) return;
+      generation = m_generation;
+    }
+
+    work();
+
+    {
+      std::lock_guard lock{m_mutex};
+      --m_busyWorkers;
+    }
+    m_done.notify_one();
+  }
+}
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard lock{m_mutex};
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+  m_workers.clear();
+}
@@ -0,0 +1,85 @@
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that split index ranges into chunks. The
+// calling thread works too, so a pool of size 1 runs everything inline.
+// Chunk boundaries depend only on the range and the chunk size, never on
+// the number of threads, so per-chunk partial results can be reduced in
+// chunk order to get the same answer with any thread count
+class ThreadPool {
+ public:
+  explicit ThreadPool(int threads = 1) { resize(threads); }
+  ~ThreadPool() { stop(); }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void resize(int threads);
+  [[nodiscard]] int size() const {
+    return static_cast<int>(m_workers.size()) + 1;
+  }
+
+  [[nodiscard]] static std::size_t chunkCount(std::size_t count,
+                                              std::size_t chunkSize) {
+    return (count + chunkSize - 1) / chunkSize;
+  }
+
+  // Calls body(chunk, begin, end) for every chunk of [0, count) and returns
+  // when all of them are done
+  template <typename Body>
+  void parallelFor(std::size_t count, std::size_t chunkSize, Body &&body);
+
+ private:
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  std::size_t m_generation{};
+  std::size_t m_busyWorkers{};
+  bool m_stopping{false};
+
+  // Current job
+  void (*m_invoke)(void *, std::size_t){};
+  void *m_context{};
+  std::size_t m_chunks{};
+  std::atomic<std::size_t> m_nextChunk{};
+
+  void run(std::size_t chunks, void (*invoke)(void *, std::size_t),
+           void *context);
+  void work();
+  void workerLoop(std::size_t generation);
+  void stop();
+};
+
+template <typename Body>
+void ThreadPool::parallelFor(std::size_t count, std::size_t chunkSize,
+                             Body &&body) {
+  if (count == 0) return;
+  if (chunkSize == 0) chunkSize = 1;
+
+  struct Context {
+    Body &body;
+    std::size_t count;
+    std::size_t chunkSize;
+  } context{body, count, chunkSize};
+
+  const auto invoke{[](void *pointer, std::size_t chunk) {
+    auto &job{*static_cast<Context *>(pointer)};
+    const auto begin{chunk * job.chunkSize};
+    const auto end{std::min(begin + job.chunkSize, job.count)};
+    job.body(chunk, begin, end);
+  }};
+
+  run(chunkCount(count, chunkSize), invoke, &context);
+}
+
+#endif
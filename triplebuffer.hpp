@@ -0,0 +1,47 @@
+#ifndef TRIPLEBUFFER_HPP_
+#define TRIPLEBUFFER_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest of a stream of values from one writer thread to one
+// reader thread without locks. The writer fills its back slot and swaps it
+// with the middle one, the reader swaps the middle one with its front slot
+// when it holds a newer value. Neither ever waits for the other; the reader
+// skips the values it was too slow to see. Slots are reused, so values that
+// keep their capacity, such as vectors, stop allocating after a few swaps
+template <typename T>
+class TripleBuffer {
+ public:
+  // Writer: the slot to fill, then publish() it
+  [[nodiscard]] T &back() { return m_slots.at(m_back); }
+  void publish() {
+    const auto previous{m_middle.exchange(
+        static_cast<std::uint8_t>(m_back | fresh), std::memory_order_acq_rel)};
+    m_back = previous & slotMask;
+  }
+
+  // Reader: moves to the newest published value, if there is one since the
+  // last call, and tells whether it did
+  bool acquire() {
+    if ((m_middle.load(std::memory_order_relaxed) & fresh) == 0) return false;
+    const auto previous{
+        m_middle.exchange(m_front, std::memory_order_acq_rel)};
+    m_front = previous & slotMask;
+    return true;
+  }
+  // Stays the same until the next acquire()
+  [[nodiscard]] const T &front() const { return m_slots.at(m_front); }
+
+ private:
+  static constexpr std::uint8_t slotMask{3};
+  static constexpr std::uint8_t fresh{4};
+
+  std::array<T, 3> m_slots{};
+  std::uint8_t m_front{0};
+  std::atomic<std::uint8_t> m_middle{1};
+  std::uint8_t m_back{2};
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "world.hpp"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cppitertools/itertools.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+// Only simulation state is rewritten: the item pool, the grid and any GPU
+// motion buffers keep their storage when the item count does not grow
+void World::restart(int quantity, unsigned int seed) {
+  const auto start{std::chrono::steady_clock::now()};
+  m_quantity = quantity;
+  m_random.seed(seed);
+
+  m_gameData.m_state = State::Playing;
+  m_objects = 0;
+  m_gameTime = 0.0f;
+  m_restartWaitTime = 0.0f;
+  m_hits.clear();
+
+  m_car.reset();
+  m_items.reset(quantity, m_random.next());
+  if (m_itemsMotion != nullptr) m_itemsMotion->upload(m_items);
+
+  m_lastRestart = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  m_stageTimes.restart += m_lastRestart;
+  ++m_rounds;
+}
+
+void World::clusterItems(float radius) {
+  if (m_itemsMotion != nullptr) m_itemsMotion->download(m_items);
+
+  // Uniform over the area of the ring
+  const auto inner{m_car.m_scale * 0.9f + Items::maxScale * 0.85f};
+  const auto count{m_items.size()};
+  auto &floats{m_items.m_randomFloats};
+  floats.resize(2 * count);
+  m_random.fillUniform(floats, 0.0f, 1.0f);
+  for (auto index : iter::range(count)) {
+    const auto distance{std::sqrt(
+        inner * inner + (radius * radius - inner * inner) * floats[2 * index])};
+    const auto angle{floats[2 * index + 1] * glm::two_pi<float>()};
+    const glm::vec2 direction{std::cos(angle), std::sin(angle)};
+
+    // Wrapped back into the world
+    const auto translation{SpatialGrid::wrappedDelta(
+        glm::vec2(0), m_car.m_translation + direction * distance)};
+    m_items.m_translations[index] = translation;
+    m_items.m_previousTranslations[index] = translation;
+  }
+  m_items.m_grid.update(m_items.m_translations, m_pool);
+
+  if (m_itemsMotion != nullptr) m_itemsMotion->upload(m_items);
+}
+
+void World::setItemsMotion(ItemsMotion *motion) {
+  if (motion == m_itemsMotion) return;
+
+  if (m_itemsMotion != nullptr) {
+    m_itemsMotion->download(m_items);
+    m_items.m_grid.update(m_items.m_translations, m_pool);
+  }
+  m_itemsMotion = motion;
+  if (m_itemsMotion != nullptr) m_itemsMotion->upload(m_items);
+}
+
+void World::step(float deltaTime) {
+  const auto allocations{m_items.poolStats().allocations};
+
+  if (m_gameData.m_state != State::Playing) {
+    // Nothing moves on the end screen, and restart() throws it all away
+    if (m_restartWaitTime > restartDelay) {
+      restart(m_quantity, m_random.next());
+    } else {
+      m_restartWaitTime += deltaTime;
+    }
+    m_stepAllocations = m_items.poolStats().allocations - allocations;
+    return;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const auto seconds{[](Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+  }};
+
+  const auto start{Clock::now()};
+  m_car.update(m_gameData, deltaTime);
+  const auto carDone{Clock::now()};
+  if (m_itemsMotion != nullptr) {
+    m_itemsMotion->advance(m_car.m_velocity * deltaTime, deltaTime);
+  } else {
+    m_items.update(m_car, deltaTime, m_pool);
+  }
+  const auto itemsDone{Clock::now()};
+
+  m_stageTimes.car += seconds(start, carDone);
+  m_stageTimes.items += seconds(carDone, itemsDone);
+  if (m_profiler != nullptr) {
+    m_profiler->add(Profiler::Stage::ItemsUpdate, carDone,
+                    seconds(carDone, itemsDone));
+  }
+
+  m_gameTime += deltaTime;
+
+  checkCollisions(deltaTime);
+  const auto collisionsDone{Clock::now()};
+  checkWinCondition();
+
+  m_stageTimes.collisions += seconds(itemsDone, collisionsDone);
+  m_stageTimes.winCondition += seconds(collisionsDone, Clock::now());
+  if (m_profiler != nullptr) {
+    m_profiler->add(Profiler::Stage::Collisions, itemsDone,
+                    seconds(itemsDone, collisionsDone));
+  }
+
+  m_stepAllocations = m_items.poolStats().allocations - allocations;
+}
+
+// The cells around the car are split into fixed chunks, and the hits of
+// each chunk are appended in chunk order, so the hit list and the count in
+// m_objects are the same for any number of threads. With an ItemsMotion, only
+// the candidates it reports are tested, in index order
+//
+// Swept: each item is tested along its whole path over the tick, relative
+// to the car, so that a fast car or a long tick does not skip over items.
+// Relative to the car, an item moves by its own drift minus the car offset
+// that scrolls the world and the sideways steering of the car
+void World::checkCollisions(float deltaTime) {
+  const auto carRadius{m_car.m_scale * 0.9f};
+  const auto carMotion{m_car.m_velocity * deltaTime + m_car.m_translation -
+                       m_car.m_previousTranslation};
+  const auto sweptDistance{[&](std::size_t index, glm::vec2 translation) {
+    const auto motion{m_items.m_velocities[index] * deltaTime - carMotion};
+    return SpatialGrid::wrappedSegmentDistance(
+        m_car.m_translation, translation - motion, motion);
+  }};
+
+  // An item hit at some point of the tick ends it up to the whole car
+  // motion behind the car, plus its own drift
+  const auto center{m_car.m_translation - carMotion * 0.5f};
+  const auto reach{carRadius + Items::maxScale * 0.85f +
+                   glm::length(carMotion) * 0.5f + Items::speed * deltaTime};
+  const auto &grid{m_items.m_grid};
+
+  if (m_itemsMotion != nullptr) {
+    m_itemsMotion->candidates(center, reach, m_candidates);
+    m_chunkHits.resize(1);
+    m_chunkHits.front().clear();
+    for (const auto &candidate : m_candidates) {
+      const auto index{static_cast<std::size_t>(candidate.m_index)};
+      m_items.m_translations[index] = candidate.m_translation;
+
+      const auto distance{sweptDistance(index, candidate.m_translation)};
+      if (distance < carRadius + m_items.m_scales[index] * 0.85f) {
+        m_chunkHits.front().push_back(index);
+      }
+    }
+    resolveHits();
+    return;
+  }
+
+  grid.cellsNear(center, reach, m_nearCells);
+
+  const std::size_t cellChunk{16};
+  m_chunkHits.resize(ThreadPool::chunkCount(m_nearCells.size(), cellChunk));
+  m_pool.parallelFor(
+      m_nearCells.size(), cellChunk, [&](auto chunk, auto begin, auto end) {
+        auto &hits{m_chunkHits[chunk]};
+        hits.clear();
+        for (auto cell{begin}; cell < end; ++cell) {
+          for (const auto index : grid.cell(m_nearCells[cell])) {
+            const auto distance{
+                sweptDistance(index, m_items.m_translations[index])};
+
+            if (distance < carRadius + m_items.m_scales[index] * 0.85f) {
+              hits.push_back(index);
+            }
+          }
+        }
+      });
+
+  resolveHits();
+}
+
+// Collects the hits of every chunk, spawns the children of large items and
+// removes the collected ones
+void World::resolveHits() {
+  for (const auto &hits : m_chunkHits) {
+    for (const auto index : hits) {
+      m_items.m_alive[index] = 0;
+      m_hits.push_back(index);
+    }
+  }
+  // Children spawn in index order, not in the order of the grid cells,
+  // which depends on the history of the grid and is not kept by snapshots
+  std::sort(m_hits.begin(), m_hits.end());
+  m_objects += static_cast<int>(m_hits.size());
+
+  const auto firstChild{m_items.size()};
+  for (const auto index : m_hits) {
+    const auto scale{m_items.m_scales[index]};
+    if (scale > 0.10f) {
+      const auto translation{m_items.m_translations[index]};
+      std::array<float, 6> offsets{};
+      m_random.fillUniform(offsets, -1.0f, 1.0f);
+      std::array<glm::vec2, 3> children{};
+      for (auto child : iter::range(children.size())) {
+        const glm::vec2 offset{offsets.at(2 * child),
+                               offsets.at(2 * child + 1)};
+        children.at(child) = translation + offset * scale * 0.5f;
+      }
+      m_items.createItems(children, scale * 0.5f);
+    }
+  }
+
+  if (m_itemsMotion != nullptr && m_items.size() > firstChild) {
+    m_itemsMotion->append(m_items, firstChild);
+  }
+
+  m_items.removeDeadItems(m_hits);
+  if (m_itemsMotion != nullptr) m_itemsMotion->remove(m_hits);
+  m_hits.clear();
+}
+
+void World::copyFrame(Frame &frame, bool withItems) const {
+  frame.m_gameData = m_gameData;
+  frame.m_car = m_car;
+  if (withItems && m_itemsMotion == nullptr) {
+    frame.m_items.copyDrawState(m_items);
+  } else {
+    frame.m_items.copyDrawState(Items{});
+  }
+  frame.m_objects = m_objects;
+  frame.m_rounds = m_rounds;
+  frame.m_threads = threads();
+  frame.m_lastRestartSeconds = m_lastRestart;
+  frame.m_secondsToRestart = secondsToRestart();
+  frame.m_pool = m_items.poolStats();
+  frame.m_stageTimes = m_stageTimes;
+}
+
+std::uint64_t World::checksum() const {
+  auto hash{m_items.checksum()};
+  for (const auto value :
+       {m_car.m_translation.x, m_car.m_translation.y, m_car.m_rotation,
+        m_car.m_velocity.x, m_car.m_velocity.y}) {
+    std::uint32_t bits{};
+    std::memcpy(&bits, &value, sizeof(bits));
+    hash = (hash ^ bits) * 1099511628211ULL;
+  }
+  return (hash ^ static_cast<std::uint64_t>(m_objects)) * 1099511628211ULL;
+}
+
+void World::checkWinCondition() {
+  if (m_gameTime > 10) {
+    m_gameData.m_state = State::Win;
+    m_restartWaitTime = 0.0f;
+    freeze();
+  }
+}
+
+// The previous state becomes the current one, so that rendering between
+// the two shows the items still for the rest of the round
+void World::freeze() {
+  m_car.m_previousTranslation = m_car.m_translation;
+  m_car.m_previousRotation = m_car.m_rotation;
+  if (m_itemsMotion != nullptr) {
+    m_itemsMotion->advance(glm::vec2(0), 0.0f);
+  } else {
+    m_items.m_previousTranslations = m_items.m_translations;
+    m_items.m_previousRotations = m_items.m_rotations;
+  }
+}
@@ -0,0 +1,140 @@
+#ifndef WORLD_HPP_
+#define WORLD_HPP_
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "car.hpp"
+#include "gamedata.hpp"
+#include "items.hpp"
+#include "itemsmotion.hpp"
+#include "philox.hpp"
+#include "profiler.hpp"
+#include "threadpool.hpp"
+
+class OpenGLWindow;
+class Snapshot;
+
+// Game simulation without any GL state: the car, the items and the rules of
+// a round. Time only advances through step()
+class World {
+ public:
+  void restart(int quantity, unsigned int seed);
+  void step(float deltaTime);
+
+  // Worker threads for the item update and the collision pass. Results do
+  // not depend on the thread count
+  void setThreads(int threads) { m_pool.resize(threads); }
+  [[nodiscard]] int threads() const { return m_pool.size(); }
+
+  // Hands item motion over to motion, or back to Items::update when null.
+  // The item state is copied across on every switch
+  void setItemsMotion(ItemsMotion *motion);
+  [[nodiscard]] ItemsMotion *itemsMotion() const { return m_itemsMotion; }
+
+  void setInput(std::bitset<4> input) { m_gameData.m_input = input; }
+
+  // Seed of the item mesh pool that drawing builds, which the items' mesh
+  // indices refer to. Restarts keep it, snapshots carry it
+  void setMeshSeed(unsigned int seed) { m_meshSeed = seed; }
+  [[nodiscard]] unsigned int meshSeed() const { return m_meshSeed; }
+
+  // Moves every item to a random spot of the ring between the collision
+  // reach of the car and radius around it: a crowded worst case for the
+  // collision pass, for benchmark snapshots
+  void clusterItems(float radius);
+
+  [[nodiscard]] const Car &car() const { return m_car; }
+  [[nodiscard]] const Items &items() const { return m_items; }
+  [[nodiscard]] const GameData &gameData() const { return m_gameData; }
+  [[nodiscard]] int objects() const { return m_objects; }
+
+  // Rounds end after 10 s and restart after restartDelay s on the end
+  // screen, where nothing moves. Outside of it, a whole delay is left
+  static constexpr float restartDelay{5.0f};
+  [[nodiscard]] float secondsToRestart() const {
+    return m_gameData.m_state == State::Playing
+               ? restartDelay
+               : std::max(0.0f, restartDelay - m_restartWaitTime);
+  }
+  [[nodiscard]] std::uint64_t checksum() const;
+
+  // Pool allocations made by the last call to step()
+  [[nodiscard]] int stepAllocations() const { return m_stepAllocations; }
+
+  // Accumulated wall time of each stage of step(), in seconds
+  struct StageTimes {
+    double car{};
+    double items{};
+    double collisions{};
+    double winCondition{};
+    double restart{};
+  };
+
+  [[nodiscard]] const StageTimes &stageTimes() const { return m_stageTimes; }
+
+  // What drawing and the UI read of the World, copied out after a tick so
+  // that the World can go on stepping on another thread
+  struct Frame {
+    GameData m_gameData;
+    Car m_car;
+    Items m_items;
+    int m_objects{};
+    int m_rounds{};
+    int m_threads{1};
+    double m_lastRestartSeconds{};
+    float m_secondsToRestart{restartDelay};
+    Items::PoolStats m_pool;
+    StageTimes m_stageTimes;
+  };
+  // Without withItems, or when they move on the GPU, the items are left out
+  // for drawing them from elsewhere
+  void copyFrame(Frame &frame, bool withItems = true) const;
+
+  // Rounds started by restart(), and the wall time of the last one
+  [[nodiscard]] int rounds() const { return m_rounds; }
+  [[nodiscard]] double lastRestartSeconds() const { return m_lastRestart; }
+
+  // Also reports the item update and collision stages to profiler
+  void setProfiler(Profiler *profiler) { m_profiler = profiler; }
+
+ private:
+  friend OpenGLWindow;
+  friend Snapshot;
+
+  GameData m_gameData;
+
+  Car m_car;
+  Items m_items;
+
+  int m_quantity{};
+  unsigned int m_meshSeed{};
+  int m_rounds{};
+  double m_lastRestart{};
+  int m_objects{};
+  int m_stepAllocations{};
+  float m_gameTime{};
+  float m_restartWaitTime{};
+
+  Philox m_random;
+  std::vector<std::size_t> m_hits;
+
+  ThreadPool m_pool;
+  std::vector<int> m_nearCells;
+  std::vector<std::vector<std::size_t>> m_chunkHits;
+
+  ItemsMotion *m_itemsMotion{};
+  std::vector<ItemsMotion::Candidate> m_candidates;
+
+  StageTimes m_stageTimes;
+  Profiler *m_profiler{};
+
+  void checkCollisions(float deltaTime);
+  void resolveHits();
+  void checkWinCondition();
+  void freeze();
+};
+
+#endif